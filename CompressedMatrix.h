@@ -0,0 +1,635 @@
+#ifndef CompressedMatrix_H
+#define CompressedMatrix_H
+
+#include <vector>
+#include <algorithm> // std::lower_bound
+#include <iterator> // std::forward_iterator_tag
+#include <cstddef>  // std::ptrdiff_t
+#include "SparseMatrix.h"
+
+/**
+	@file CompressedMatrix.h
+	@brief Dichiarazione delle classi template CsrMatrix e CscMatrix
+*/
+
+
+/**
+	Classe base delle matrici compresse (CSR e CSC). Memorizza gli elementi
+	raggruppati per indice "esterno" (riga per CSR, colonna per CSC) in tre
+	array: puntatori di inizio, indici "interni" e valori.
+	La matrice e' immutabile: viene costruita una sola volta a partire da
+	una SparseMatrix e poi letta.
+
+	@brief Base delle matrici compresse
+
+	Le coordinate sono di tipo I, come in SparseMatrix; i puntatori di
+	inizio e il numero di elementi sono di tipo size_type, quindi il numero
+	di elementi non e' limitato da I.
+
+	@param T tipo del dato
+	@param ByRow true per la compressione per righe (CSR), false per colonne (CSC)
+	@param I tipo intero senza segno delle coordinate
+*/
+template <typename T, bool ByRow, typename I = unsigned int>
+class CompressedMatrix {
+
+public:
+	typedef I sm_size; ///< tipo delle coordinate
+	typedef std::size_t size_type; ///< tipo del numero di elementi e delle posizioni
+	typedef T value_type; ///< tipo contenuto nella matrice
+	typedef typename SparseMatrix<T, std::allocator<T>, I>::element element; ///< elemento della matrice
+
+	/**
+		Vista di sola lettura su una riga (CSR) o una colonna (CSC) della matrice.
+		Non possiede i dati, che restano nella matrice compressa.
+
+		@brief fetta di una riga o di una colonna
+	*/
+	struct slice {
+		const sm_size *index; ///< indici degli elementi (colonne per CSR, righe per CSC)
+		const value_type *values; ///< valori degli elementi
+		size_type size; ///< numero di elementi della fetta
+	};
+
+	/**
+		@brief numero di righe della matrice
+
+		@return numero di righe della matrice
+	*/
+	sm_size getNumRows() const {
+		return _nRows;
+	}
+
+	/**
+		@brief numero di colonne della matrice
+
+		@return numero di colonne della matrice
+	*/
+	sm_size getNumCols() const {
+		return _nCols;
+	}
+
+	/**
+		@brief numero di elementi memorizzati nella matrice
+
+		@return numero di elementi memorizzati
+	*/
+	size_type getNumElement() const {
+		return _values.size();
+	}
+
+	/**
+		@brief valore di default della matrice
+
+		@return valore di default
+	*/
+	const value_type& getDefaultValue() const {
+		return _D;
+	}
+
+	/**
+		@brief Accesso ai dati in lettura
+
+		Metodo per leggere il valore dell'elemento in posizione (i,j).
+		L'elemento viene cercato con una ricerca binaria sulla sola riga
+		(o colonna) che lo contiene.
+
+		@param ii indice della riga
+		@param jj indice della colonna
+
+		@return valore dell'elemento in posizione (ii,jj)
+
+		@throw index_out_of_bounds_exception
+	*/
+	const value_type& operator()(const sm_size ii, const sm_size jj) const {
+		if(ii >= _nRows || jj >= _nCols)
+			throw index_out_of_bounds_exception();
+
+		const sm_size outer = ByRow ? ii : jj;
+		const sm_size inner = ByRow ? jj : ii;
+
+		typename std::vector<sm_size>::const_iterator first = _index.begin() + _ptr[outer];
+		typename std::vector<sm_size>::const_iterator last = _index.begin() + _ptr[outer + 1];
+		typename std::vector<sm_size>::const_iterator pos = std::lower_bound(first, last, inner);
+
+		if(pos != last && *pos == inner)
+			return _values[pos - _index.begin()];
+
+		return _D;
+	}
+
+	/**
+		Iteratore costante della matrice compressa. Restituisce gli elementi
+		per valore, in ordine di riga per CSR e di colonna per CSC.
+
+		@brief Iteratore costante della matrice compressa
+	*/
+	class const_iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef element reference;
+
+		/**
+			Oggetto restituito da operator->, contiene una copia dell'elemento
+
+			@brief proxy per operator->
+		*/
+		struct pointer {
+			element e; ///< elemento puntato
+
+			/**
+				@brief accesso all'elemento
+				@return puntatore all'elemento
+			*/
+			const element* operator->() const {
+				return &e;
+			}
+		};
+
+		/**
+			Costruttore dell'iteratore costante
+			@brief Setta la matrice a nullptr
+		*/
+		const_iterator() : _m(nullptr), _outer(0), _k(0) {}
+
+		/**
+			ritorna il dato riferito dall'iteratore (dereferenziamento)
+
+			@brief operatore di deferenziamento
+
+			@return struct element
+		*/
+		reference operator*() const {
+			const sm_size inner = _m -> _index[_k];
+			return element(ByRow ? _outer : inner, ByRow ? inner : _outer, _m -> _values[_k]);
+		}
+
+		/**
+			ritorna il dato riferito dall'iteratore
+
+			@brief operatore ->
+
+			@return proxy che punta ad un element
+		*/
+		pointer operator->() const {
+			pointer p = { **this };
+			return p;
+		}
+
+		/**
+			Operatore di post-incremento dell'iteratore
+
+			@brief operatore di post-incremento
+
+			@return l'iteratore pre incremento
+		*/
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		/**
+			Operatore di pre-incremento dell'iteratore
+
+			@brief operatore di pre-incremento
+
+			@return l'iteratore incrementato
+		*/
+		const_iterator& operator++() {
+			++_k;
+			skip();
+			return *this;
+		}
+
+		/**
+			@brief Operatore di uguaglianza
+
+			@param un altro const_iterator other
+			@return Risultato dell'uguaglianza
+		*/
+		bool operator==(const const_iterator &other) const {
+			return _m == other._m && _k == other._k;
+		}
+
+		/**
+			@brief Operatore di diseguaglianza
+
+			@param un altro const_iterator other
+			@return Risultato della diseguaglianza
+		*/
+		bool operator!=(const const_iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		const CompressedMatrix *_m; ///< matrice su cui si itera
+		sm_size _outer; ///< riga (CSR) o colonna (CSC) corrente
+		size_type _k; ///< posizione corrente negli array degli elementi
+
+		friend class CompressedMatrix;
+
+		const_iterator(const CompressedMatrix *m, const sm_size outer, const size_type k) : _m(m), _outer(outer), _k(k) {}
+
+		// avanza l'indice esterno fino alla riga (colonna) che contiene _k
+		void skip() {
+			while(_outer + 1 < _m -> _ptr.size() && _m -> _ptr[_outer + 1] <= _k)
+				++_outer;
+		}
+	}; // classe const_iterator
+
+	/**
+		Ritorna l'iteratore all'inizio della sequenza dati
+
+		@return iteratore all'inizio della sequenza
+	*/
+	const_iterator begin() const {
+		const_iterator it(this, 0, 0);
+		it.skip(); // salto le righe (colonne) vuote iniziali
+		return it;
+	}
+
+	/**
+		Ritorna l'iteratore alla fine della sequenza dati
+
+		@return iteratore alla fine della sequenza
+	*/
+	const_iterator end() const {
+		return const_iterator(this, static_cast<sm_size>(_ptr.size() - 1), getNumElement());
+	}
+
+	/**
+		@brief array dei puntatori di inizio riga (CSR) o colonna (CSC)
+
+		@return array di dimensione (numero di righe/colonne + 1)
+	*/
+	const std::vector<size_type>& pointers() const {
+		return _ptr;
+	}
+
+	/**
+		@brief array degli indici di colonna (CSR) o di riga (CSC)
+
+		@return array degli indici
+	*/
+	const std::vector<sm_size>& indices() const {
+		return _index;
+	}
+
+	/**
+		@brief array dei valori
+
+		@return array dei valori
+	*/
+	const std::vector<value_type>& values() const {
+		return _values;
+	}
+
+protected:
+	std::vector<size_type> _ptr; ///< inizio di ogni riga (colonna) negli array _index e _values
+	std::vector<sm_size> _index; ///< indice interno di ogni elemento
+	std::vector<value_type> _values; ///< valore di ogni elemento
+	value_type _D; ///< valore di default
+	sm_size _nRows; ///< numero di righe
+	sm_size _nCols; ///< numero di colonne
+
+	/**
+		@brief Costruttore secondario
+
+		Inizializza dimensioni e valore di default, gli array sono riempiti
+		dalle classi derivate. La matrice di origine puo' avere coordinate di
+		qualunque tipo, purche' le dimensioni siano rappresentabili con sm_size.
+
+		@param sm matrice sparsa di origine
+
+		@throw index_out_of_bounds_exception se le dimensioni non sono rappresentabili
+	*/
+	template <typename A, typename J, typename S>
+	explicit CompressedMatrix(const SparseMatrix<T, A, J, S> &sm)
+		: _D(sm.getDefaultValue()), _nRows(static_cast<sm_size>(sm.getNumRows())), _nCols(static_cast<sm_size>(sm.getNumCols())) {
+		if(_nRows != sm.getNumRows() || _nCols != sm.getNumCols())
+			throw index_out_of_bounds_exception();
+
+		_ptr.assign(static_cast<size_t>(ByRow ? _nRows : _nCols) + 1, 0);
+		_index.reserve(sm.getNumElement());
+		_values.reserve(sm.getNumElement());
+	}
+
+	/**
+		@brief contributo del valore di default, _D * somma(x)
+
+		@param x vettore di ingresso, getNumCols() elementi
+		@param zeroDefault true se il valore di default e' T()
+		@return _D * somma(x), oppure T() se il valore di default e' T()
+	*/
+	value_type defaultContribution(const value_type *x, const bool zeroDefault) const {
+		value_type sum = value_type();
+		if(zeroDefault)
+			return sum;
+
+		for(sm_size c = 0; c < _nCols; ++c)
+			sum += x[c];
+		return _D * sum;
+	}
+
+	/**
+		@brief fetta della riga (colonna) outer
+
+		@param outer indice della riga (colonna)
+		@return fetta con indici e valori
+
+		@throw index_out_of_bounds_exception
+	*/
+	slice outerSlice(const sm_size outer) const {
+		if(outer + 1 >= _ptr.size())
+			throw index_out_of_bounds_exception();
+
+		slice s = { _index.data() + _ptr[outer], _values.data() + _ptr[outer], _ptr[outer + 1] - _ptr[outer] };
+		return s;
+	}
+};
+
+
+/**
+	Matrice sparsa immutabile in formato Compressed Sparse Row.
+	Viene costruita con una sola scansione degli elementi della SparseMatrix,
+	che sono gia' ordinati per riga.
+
+	@brief Matrice sparsa CSR
+
+	@param T tipo del dato
+	@param I tipo intero senza segno delle coordinate
+*/
+template <typename T, typename I = unsigned int>
+class CsrMatrix : public CompressedMatrix<T, true, I> {
+	typedef CompressedMatrix<T, true, I> base;
+
+public:
+	typedef typename base::sm_size sm_size;
+	typedef typename base::size_type size_type;
+	typedef typename base::slice slice;
+
+	/**
+		@brief Costruttore secondario
+
+		Costruisce la matrice CSR in O(nnz) a partire da una matrice sparsa.
+
+		@param sm matrice sparsa da comprimere
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	template <typename A, typename J, typename S>
+	explicit CsrMatrix(const SparseMatrix<T, A, J, S> &sm) : base(sm) {
+		typename SparseMatrix<T, A, J, S>::const_iterator i, ie;
+
+		// conto gli elementi di ogni riga e salvo colonne e valori nell'ordine
+		for(i = sm.begin(), ie = sm.end(); i != ie; ++i){
+			++this -> _ptr[i -> i + 1];
+			this -> _index.push_back(static_cast<sm_size>(i -> j));
+			this -> _values.push_back(i -> value);
+		}
+
+		for(sm_size r = 0; r < this -> _nRows; ++r)
+			this -> _ptr[r + 1] += this -> _ptr[r];
+	}
+
+	/**
+		@brief fetta di una riga in O(1)
+
+		@param ii indice della riga
+		@return colonne e valori della riga
+
+		@throw index_out_of_bounds_exception
+	*/
+	slice row(const sm_size ii) const {
+		return this -> outerSlice(ii);
+	}
+
+	/**
+		@brief Prodotto matrice-vettore
+
+		Calcola y = A x, dove x ha getNumCols() elementi e y getNumRows().
+		Il valore di default contribuisce a tutte le righe come in
+		SparseMatrix::multiply. Con threads > 1 le righe vengono divise in
+		blocchi con circa lo stesso numero di elementi; threads = 0 usa un
+		thread per core.
+
+		@param x vettore di ingresso, getNumCols() elementi
+		@param y vettore di uscita, getNumRows() elementi
+		@param threads numero di thread da usare
+
+		@throw std::system_error se non e' possibile creare un thread
+	*/
+	void multiply(const T *x, T *y, unsigned int threads = 1) const {
+		const bool zeroDefault = (this -> _D == T());
+		const T base = this -> defaultContribution(x, zeroDefault);
+		const sm_size nRows = this -> _nRows;
+		const std::vector<size_type> &ptr = this -> _ptr;
+
+		if(threads == 0)
+			threads = std::thread::hardware_concurrency();
+		if(threads > nRows)
+			threads = nRows;
+
+		if(threads <= 1){
+			multiply_rows(x, y, 0, nRows, base, zeroDefault);
+			return;
+		}
+
+		// il thread t prende le righe [rows[t], rows[t+1]), circa nnz / threads elementi
+		std::vector<sm_size> rows(threads + 1, nRows);
+		rows[0] = 0;
+		for(unsigned int t = 1; t < threads; ++t){
+			const size_type k = static_cast<size_type>(static_cast<unsigned long long>(this -> getNumElement()) * t / threads);
+			rows[t] = static_cast<sm_size>(std::lower_bound(ptr.begin(), ptr.end() - 1, k) - ptr.begin());
+		}
+
+		run_parallel(threads, [&](const unsigned int t){
+			multiply_rows(x, y, rows[t], rows[t + 1], base, zeroDefault);
+		});
+	}
+
+	/**
+		@brief Prodotto matrice-vettore
+
+		@param x vettore di ingresso, getNumCols() elementi
+		@param threads numero di thread da usare
+		@return vettore y = A x di getNumRows() elementi
+
+		@throw dimension_mismatch_exception se x non ha getNumCols() elementi
+		@throw std::system_error se non e' possibile creare un thread
+	*/
+	std::vector<T> multiply(const std::vector<T> &x, const unsigned int threads = 1) const {
+		if(x.size() != this -> _nCols)
+			throw dimension_mismatch_exception();
+
+		std::vector<T> y(this -> _nRows);
+		multiply(x.data(), y.data(), threads);
+		return y;
+	}
+
+private:
+	/**
+		@brief prodotto matrice-vettore sulle righe [r0, r1)
+	*/
+	void multiply_rows(const T *x, T *y, const sm_size r0, const sm_size r1, const T &base, const bool zeroDefault) const {
+		for(sm_size r = r0; r < r1; ++r){
+			const size_type k = this -> _ptr[r];
+			const size_type n = this -> _ptr[r + 1] - k;
+
+			T acc = T();
+			if(n > 0)
+				acc = row_dot(k, n, x, !zeroDefault, std::is_same<sm_size, unsigned int>());
+
+			y[r] = base + acc;
+		}
+	}
+
+	/**
+		Somma dei prodotti degli n elementi da k con spmv_kernel, vettorizzato
+		per float e double. I kernel vettorizzati leggono gli indici come
+		interi a 32 bit con segno, quindi sono usati solo se il numero di
+		colonne non supera 2^31 - 1.
+
+		@brief somma dei prodotti di una riga, indici a 32 bit
+	*/
+	T row_dot(const size_type k, const size_type n, const T *x, const bool useShift, std::true_type) const {
+		if(this -> _nCols <= 0x7fffffffu)
+			return spmv_kernel<T>::dot(this -> _index.data() + k, sizeof(sm_size), this -> _values.data() + k, sizeof(T),
+			                           n, x, this -> _D, useShift);
+
+		return row_dot(k, n, x, useShift, std::false_type());
+	}
+
+	/**
+		@brief somma dei prodotti di una riga con il ciclo scalare, per ogni tipo di indice
+	*/
+	T row_dot(const size_type k, const size_type n, const T *x, const bool useShift, std::false_type) const {
+		return spmv_scalar_dot<T>(this -> _index.data() + k, sizeof(sm_size), this -> _values.data() + k, sizeof(T),
+		                          n, x, this -> _D, useShift);
+	}
+};
+
+
+/**
+	Matrice sparsa immutabile in formato Compressed Sparse Column.
+
+	@brief Matrice sparsa CSC
+
+	@param T tipo del dato
+	@param I tipo intero senza segno delle coordinate
+*/
+template <typename T, typename I = unsigned int>
+class CscMatrix : public CompressedMatrix<T, false, I> {
+	typedef CompressedMatrix<T, false, I> base;
+
+public:
+	typedef typename base::sm_size sm_size;
+	typedef typename base::size_type size_type;
+	typedef typename base::slice slice;
+
+	/**
+		@brief Costruttore secondario
+
+		Costruisce la matrice CSC in O(nnz + colonne): una scansione conta gli
+		elementi di ogni colonna, una seconda li colloca. Poiche' la SparseMatrix
+		e' ordinata per riga, le righe di ogni colonna risultano gia' ordinate.
+
+		@param sm matrice sparsa da comprimere
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	template <typename A, typename J, typename S>
+	explicit CscMatrix(const SparseMatrix<T, A, J, S> &sm) : base(sm) {
+		typename SparseMatrix<T, A, J, S>::const_iterator i, ie;
+
+		for(i = sm.begin(), ie = sm.end(); i != ie; ++i)
+			++this -> _ptr[i -> j + 1];
+
+		for(sm_size c = 0; c < this -> _nCols; ++c)
+			this -> _ptr[c + 1] += this -> _ptr[c];
+
+		this -> _index.resize(sm.getNumElement());
+		this -> _values.resize(sm.getNumElement(), sm.getDefaultValue());
+
+		std::vector<size_type> next(this -> _ptr.begin(), this -> _ptr.end() - 1);
+		for(i = sm.begin(), ie = sm.end(); i != ie; ++i){
+			const size_type pos = next[i -> j]++;
+			this -> _index[pos] = static_cast<sm_size>(i -> i);
+			this -> _values[pos] = i -> value;
+		}
+	}
+
+	/**
+		@brief fetta di una colonna in O(1)
+
+		@param jj indice della colonna
+		@return righe e valori della colonna
+
+		@throw index_out_of_bounds_exception
+	*/
+	slice column(const sm_size jj) const {
+		return this -> outerSlice(jj);
+	}
+
+	/**
+		@brief Prodotto matrice-vettore
+
+		Calcola y = A x scorrendo le colonne, dove x ha getNumCols() elementi
+		e y getNumRows(). Il valore di default contribuisce come in
+		SparseMatrix::multiply. Poiche' ogni colonna aggiorna righe sparse,
+		il calcolo e' sequenziale: per il prodotto parallelo usare CsrMatrix.
+
+		@param x vettore di ingresso, getNumCols() elementi
+		@param y vettore di uscita, getNumRows() elementi
+	*/
+	void multiply(const T *x, T *y) const {
+		const bool zeroDefault = (this -> _D == T());
+		const T base = this -> defaultContribution(x, zeroDefault);
+
+		for(sm_size r = 0; r < this -> _nRows; ++r)
+			y[r] = base;
+
+		for(sm_size c = 0; c < this -> _nCols; ++c)
+			for(size_type k = this -> _ptr[c]; k < this -> _ptr[c + 1]; ++k)
+				y[this -> _index[k]] += (zeroDefault ? this -> _values[k] : this -> _values[k] - this -> _D) * x[c];
+	}
+
+	/**
+		@brief Prodotto matrice-vettore
+
+		@param x vettore di ingresso, getNumCols() elementi
+		@return vettore y = A x di getNumRows() elementi
+
+		@throw dimension_mismatch_exception se x non ha getNumCols() elementi
+	*/
+	std::vector<T> multiply(const std::vector<T> &x) const {
+		if(x.size() != this -> _nCols)
+			throw dimension_mismatch_exception();
+
+		std::vector<T> y(this -> _nRows);
+		multiply(x.data(), y.data());
+		return y;
+	}
+};
+
+
+/**
+	@brief congela una matrice sparsa in formato CSR
+
+	Crea una copia immutabile in formato CSR della matrice sparsa, adatta
+	alle fasi di sola lettura.
+
+	@param sm matrice sparsa da congelare
+	@return matrice CSR equivalente, con lo stesso tipo delle coordinate
+
+	@throw eccezione di allocazione di memoria (runtime)
+*/
+template <typename T, typename A, typename I, typename S>
+CsrMatrix<T, I> freeze(const SparseMatrix<T, A, I, S> &sm){
+	return CsrMatrix<T, I>(sm);
+}
+
+#endif
@@ -0,0 +1,399 @@
+#ifndef ConcurrentMatrix_H
+#define ConcurrentMatrix_H
+
+#include <vector>
+#include <algorithm>  // std::min
+#include <memory>  // std::unique_ptr
+#include <mutex>
+#include <new>  // std::bad_alloc
+#include <cstdlib>  // posix_memalign, std::free
+#include <system_error>
+#include <tuple>
+#if __cplusplus >= 201703L
+#include <shared_mutex>  // std::shared_mutex
+#else
+#include <pthread.h>  // pthread_rwlock_t
+#endif
+#include "SparseMatrix.h"
+
+/**
+	@file ConcurrentMatrix.h
+	@brief Dichiarazione della classe templata ConcurrentMatrix
+*/
+
+
+/**
+	Matrice sparsa che puo' essere letta e modificata da piu' thread
+	contemporaneamente. Le righe sono divise in blocchi contigui (shard),
+	ognuno con la propria SparseMatrix e il proprio lock: letture e
+	inserimenti su shard diversi non si contendono nulla. Il lock e' di
+	lettura/scrittura (std::shared_mutex con C++17, pthread_rwlock_t prima),
+	quindi anche le letture sullo stesso shard procedono in parallelo. Ogni
+	shard e' allineato a 64 byte e occupa un multiplo di 64 byte, cosi' il
+	suo lock non condivide linee di cache con altri dati.
+
+	Le letture restituiscono il valore per copia, perche' un riferimento
+	non resterebbe valido dopo il rilascio del lock. L'iterazione con
+	for_each e la copia con toSparseMatrix bloccano tutti gli shard, in
+	ordine, e vedono quindi uno stato consistente dell'intera matrice.
+
+	@brief Matrice sparsa concorrente divisa in blocchi di righe
+
+	@param T tipo del dato
+	@param I tipo delle coordinate
+*/
+template <typename T, typename I = unsigned int>
+class ConcurrentMatrix {
+
+public:
+	typedef SparseMatrix<T, std::allocator<T>, I> matrix_type; ///< matrice di ogni shard
+	typedef I sm_size; ///< tipo delle coordinate
+	typedef std::size_t size_type; ///< tipo del numero di elementi
+	typedef T value_type; ///< tipo contenuto nella matrice
+
+	/**
+		@brief Costruttore secondario
+
+		Istanzia una matrice vuota con una data dimensione e un valore di
+		default, divisa in shards blocchi di righe (al piu' uno per riga).
+
+		@param r numero di righe della matrice
+		@param c numero di colonne della matrice
+		@param dv valore di default degli elementi della matrice
+		@param shards numero di blocchi di righe
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	ConcurrentMatrix(const sm_size r, const sm_size c, const value_type &dv, unsigned int shards = 64)
+		: _D(dv), _nRows(r), _nCols(c) {
+		if(shards == 0)
+			shards = 1;
+		if(r > 0 && static_cast<size_type>(shards) > static_cast<size_type>(r))
+			shards = static_cast<unsigned int>(r);
+
+		_blockRows = r > 0 ? (static_cast<size_type>(r) + shards - 1) / shards : 1;
+		_nShards = r > 0 ? static_cast<unsigned int>((static_cast<size_type>(r) + _blockRows - 1) / _blockRows) : 1;
+
+		_shards.reserve(_nShards);
+		for(unsigned int s = 0; s < _nShards; ++s){
+			const size_type first = s * _blockRows;
+			const size_type rows = r > 0 ? std::min(_blockRows, static_cast<size_type>(r) - first) : 0;
+			_shards.push_back(std::unique_ptr<shard>(new shard(static_cast<sm_size>(rows), c, dv)));
+		}
+	}
+
+	ConcurrentMatrix(const ConcurrentMatrix &) = delete;
+	ConcurrentMatrix& operator=(const ConcurrentMatrix &) = delete;
+
+	/**
+		@brief Inserimento di un elemento nella matrice
+
+		Inserisce un elemento in posizione (ii,jj) con valore value bloccando
+		in scrittura soltanto lo shard della riga ii. Se la cella e' gia'
+		inizializzata sostituisce soltanto il valore.
+
+		@param ii indice della riga
+		@param jj indice della colonna
+		@param value valore da inserire
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	void add(const sm_size ii, const sm_size jj, const value_type &value){
+		if(ii >= _nRows || jj >= _nCols)
+			throw index_out_of_bounds_exception();
+
+		shard &s = *_shards[ii / _blockRows];
+		write_lock lock(s.lock);
+		s.m.add(static_cast<sm_size>(ii % _blockRows), jj, value);
+	}
+
+	/**
+		@brief Accesso ai dati in lettura
+
+		Legge il valore in posizione (ii,jj) bloccando in lettura soltanto
+		lo shard della riga ii.
+
+		@param ii indice della riga
+		@param jj indice della colonna
+		@return copia del valore dell'elemento in posizione (ii,jj)
+
+		@throw index_out_of_bounds_exception
+	*/
+	value_type operator()(const sm_size ii, const sm_size jj) const {
+		if(ii >= _nRows || jj >= _nCols)
+			throw index_out_of_bounds_exception();
+
+		const shard &s = *_shards[ii / _blockRows];
+		read_lock lock(s.lock);
+		return s.m(static_cast<sm_size>(ii % _blockRows), jj);
+	}
+
+	/**
+		@brief Iterazione consistente
+
+		Blocca in lettura tutti gli shard e chiama f(i, j, value) per ogni
+		elemento inserito, in ordine di riga. Durante la visita la matrice
+		non puo' essere modificata, quindi f vede un unico stato; f non deve
+		usare la matrice, neanche in lettura: con uno scrittore in attesa
+		il secondo lock in lettura non verrebbe mai concesso.
+
+		@param f funzione chiamata per ogni elemento
+	*/
+	template <typename F>
+	void for_each(F f) const {
+		std::vector<read_lock> locks;
+		lock_all(locks);
+
+		for(unsigned int s = 0; s < _nShards; ++s){
+			const size_type first = s * _blockRows;
+			const matrix_type &m = _shards[s] -> m;
+			for(typename matrix_type::const_iterator k = m.begin(), ke = m.end(); k != ke; ++k)
+				f(static_cast<sm_size>(first + k -> i), k -> j, k -> value);
+		}
+	}
+
+	/**
+		@brief Copia consistente in una SparseMatrix
+
+		Blocca in lettura tutti gli shard e costruisce la matrice con
+		assign_sorted dai loro elementi, gia' ordinati, shard dopo shard:
+		una sola allocazione e nessuna ricerca.
+
+		@return matrice sparsa con gli stessi elementi
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	matrix_type toSparseMatrix() const {
+		std::vector<read_lock> locks;
+		lock_all(locks);
+
+		matrix_type sm(_nRows, _nCols, _D);
+		sm.assign_sorted(element_iterator(this, 0), element_iterator(this, _nShards));
+		return sm;
+	}
+
+	/**
+		@brief numero di elementi inseriti nella matrice
+
+		Blocca tutti gli shard, quindi il conteggio e' consistente.
+
+		@return numero di elementi inseriti
+	*/
+	size_type getNumElement() const {
+		std::vector<read_lock> locks;
+		lock_all(locks);
+
+		size_type n = 0;
+		for(unsigned int s = 0; s < _nShards; ++s)
+			n += _shards[s] -> m.getNumElement();
+		return n;
+	}
+
+	/**
+		@brief numero di righe della matrice
+		@return numero di righe della matrice
+	*/
+	sm_size getNumRows() const {
+		return _nRows;
+	}
+
+	/**
+		@brief numero di colonne della matrice
+		@return numero di colonne della matrice
+	*/
+	sm_size getNumCols() const {
+		return _nCols;
+	}
+
+	/**
+		@brief numero di shard
+		@return numero di blocchi di righe
+	*/
+	unsigned int getNumShards() const {
+		return _nShards;
+	}
+
+	/**
+		@brief valore di default della matrice
+		@return valore di default
+	*/
+	const value_type& getDefaultValue() const {
+		return _D;
+	}
+
+private:
+#if __cplusplus >= 201703L
+	typedef std::shared_mutex lock_type; ///< lock di uno shard
+	typedef std::shared_lock<lock_type> read_lock; ///< lock in lettura, condiviso
+#else
+	/**
+		Lock di lettura/scrittura su pthread_rwlock_t, con la stessa
+		interfaccia di std::shared_mutex (che manca prima di C++17). Il
+		pthread_rwlock_t di default favorisce i lettori e un flusso continuo
+		di letture puo' bloccare per sempre uno scrittore; con glibc il lock
+		viene quindi creato con preferenza per gli scrittori, altrove uno
+		scrittore puo' ancora attendere a lungo sotto molte letture.
+
+		@brief lock di lettura/scrittura
+	*/
+	class lock_type {
+	public:
+		lock_type(){
+			pthread_rwlockattr_t attr;
+			int err = pthread_rwlockattr_init(&attr);
+			if(err != 0)
+				throw std::system_error(err, std::system_category());
+#if defined(__GLIBC__)
+			pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+			err = pthread_rwlock_init(&_rw, &attr);
+			pthread_rwlockattr_destroy(&attr);
+			if(err != 0)
+				throw std::system_error(err, std::system_category());
+		}
+
+		~lock_type(){
+			pthread_rwlock_destroy(&_rw);
+		}
+
+		lock_type(const lock_type &) = delete;
+		lock_type& operator=(const lock_type &) = delete;
+
+		void lock(){
+			const int err = pthread_rwlock_wrlock(&_rw);
+			if(err != 0)
+				throw std::system_error(err, std::system_category());
+		}
+
+		void unlock(){
+			pthread_rwlock_unlock(&_rw);
+		}
+
+		void lock_shared(){
+			const int err = pthread_rwlock_rdlock(&_rw);
+			if(err != 0)
+				throw std::system_error(err, std::system_category());
+		}
+
+		void unlock_shared(){
+			pthread_rwlock_unlock(&_rw);
+		}
+
+	private:
+		pthread_rwlock_t _rw; ///< lock POSIX
+	};
+
+	/**
+		@brief lock in lettura, condiviso (come std::shared_lock, che manca prima di C++14)
+	*/
+	class read_lock {
+	public:
+		explicit read_lock(lock_type &l) : _l(&l) {
+			l.lock_shared();
+		}
+
+		read_lock(read_lock &&other) : _l(other._l) {
+			other._l = nullptr;
+		}
+
+		~read_lock(){
+			if(_l != nullptr)
+				_l -> unlock_shared();
+		}
+
+		read_lock(const read_lock &) = delete;
+		read_lock& operator=(const read_lock &) = delete;
+
+	private:
+		lock_type *_l; ///< lock bloccato, nullptr dopo uno spostamento
+	};
+#endif
+	typedef std::unique_lock<lock_type> write_lock; ///< lock in scrittura
+
+	/**
+		Blocco di righe con il proprio lock, allocato separatamente dagli
+		altri. L'allineamento a 64 byte tiene il lock e la matrice di uno
+		shard su linee di cache diverse da quelle degli altri shard e dei
+		dati dell'allocatore. La memoria e' chiesta con posix_memalign, che
+		rispetta l'allineamento anche senza l'operator new allineato di C++17.
+
+		@brief blocco di righe
+	*/
+	struct alignas(64) shard {
+		mutable lock_type lock; ///< lock dello shard
+		matrix_type m; ///< elementi del blocco, con righe relative all'inizio del blocco
+
+		shard(const sm_size r, const sm_size c, const value_type &dv) : m(r, c, dv) {}
+
+		static void* operator new(const std::size_t n){
+			void *p = nullptr;
+			if(posix_memalign(&p, alignof(shard), n) != 0)
+				throw std::bad_alloc();
+			return p;
+		}
+
+		static void operator delete(void *p){
+			std::free(p);
+		}
+	};
+
+	/**
+		Iteratore in avanti sugli elementi di tutti gli shard, in ordine di
+		riga e con le coordinate globali. Va usato con gli shard bloccati.
+
+		@brief iteratore sugli elementi di tutti gli shard
+	*/
+	class element_iterator {
+	public:
+		element_iterator(const ConcurrentMatrix *m, const unsigned int s) : _m(m), _s(s) {
+			if(_s < _m -> _nShards)
+				_k = _m -> _shards[_s] -> m.begin();
+			skip();
+		}
+
+		std::tuple<sm_size, sm_size, value_type> operator*() const {
+			return std::make_tuple(static_cast<sm_size>(_s * _m -> _blockRows + _k -> i), _k -> j, _k -> value);
+		}
+
+		element_iterator& operator++(){
+			++_k;
+			skip();
+			return *this;
+		}
+
+		bool operator!=(const element_iterator &other) const {
+			return _s != other._s || (_s < _m -> _nShards && _k != other._k);
+		}
+
+	private:
+		const ConcurrentMatrix *_m; ///< matrice su cui si itera
+		unsigned int _s; ///< shard corrente, _nShards alla fine
+		typename matrix_type::const_iterator _k; ///< elemento corrente dello shard
+
+		// passa al primo shard non vuoto se lo shard corrente e' finito
+		void skip(){
+			while(_s < _m -> _nShards && _k == _m -> _shards[_s] -> m.end())
+				if(++_s < _m -> _nShards)
+					_k = _m -> _shards[_s] -> m.begin();
+		}
+	};
+
+	std::vector<std::unique_ptr<shard> > _shards; ///< blocchi di righe
+	value_type _D; ///< valore di default
+	sm_size _nRows; ///< numero di righe
+	sm_size _nCols; ///< numero di colonne
+	size_type _blockRows; ///< righe per shard (l'ultimo puo' averne meno)
+	unsigned int _nShards; ///< numero di shard
+
+	/**
+		@brief blocca in lettura tutti gli shard, sempre nello stesso ordine
+	*/
+	void lock_all(std::vector<read_lock> &locks) const {
+		locks.reserve(_nShards);
+		for(unsigned int s = 0; s < _nShards; ++s)
+			locks.push_back(read_lock(_shards[s] -> lock));
+	}
+};
+
+#endif
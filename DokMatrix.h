@@ -0,0 +1,289 @@
+#ifndef DokMatrix_H
+#define DokMatrix_H
+
+#include <vector>
+#include <algorithm> // std::sort
+#include <tuple>
+#include "SparseMatrix.h"
+
+/**
+	@file DokMatrix.h
+	@brief Dichiarazione della classe templata DokMatrix
+*/
+
+
+/**
+	Matrice sparsa in formato dictionary-of-keys. Gli elementi sono salvati
+	in una tabella hash ad indirizzamento aperto (scansione lineare) con
+	chiave la coppia (i,j) impacchettata in un intero a 64 bit.
+	Inserimento e lettura costano O(1) ammortizzato indipendentemente
+	dall'ordine di arrivo delle coordinate; gli elementi non sono ordinati,
+	per iterarli in ordine si converte la matrice in una SparseMatrix.
+
+	@brief Matrice sparsa dictionary-of-keys
+
+	@param T tipo del dato
+*/
+template <typename T>
+class DokMatrix {
+
+public:
+	typedef typename SparseMatrix<T>::sm_size sm_size; ///< tipo delle coordinate
+	typedef T value_type; ///< tipo contenuto nella matrice
+
+	/**
+		@brief Costruttore secondario
+
+		Istanzia una matrice vuota con una data dimensione e un valore di default.
+
+		@param r numero di righe della matrice
+		@param c numero di colonne della matrice
+		@param dv valore di default degli elementi della matrice
+	*/
+	DokMatrix(const sm_size r, const sm_size c, const value_type &dv)
+		: _D(dv), _size(0), _nRows(r), _nCols(c) {}
+
+	/**
+		@brief Inserimento di un elemento nella matrice
+
+		Inserisce un elemento in posizione (ii,jj) con valore value. Se la
+		cella e' gia' inizializzata sostituisce soltanto il valore.
+
+		@param ii indice della riga
+		@param jj indice della colonna
+		@param value valore da inserire
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	void add(const sm_size ii, const sm_size jj, const value_type &value){
+		if(ii >= _nRows || jj >= _nCols)
+			throw index_out_of_bounds_exception();
+
+		const key_type k = pack(ii, jj);
+		size_t pos = 0;
+		if(!_keys.empty()){
+			pos = find(k);
+			if(_keys[pos] == k){
+				_values[pos] = value; // sovrascrittura: la tabella non cresce
+				return;
+			}
+		}
+
+		// nuova chiave: tengo il fattore di carico sotto 1/2
+		if(2 * (_size + 1) > _keys.size()){
+			rehash(_keys.empty() ? 16 : _keys.size() * 2);
+			pos = find(k);
+		}
+
+		_values[pos] = value;
+		_keys[pos] = k;
+		++_size;
+	}
+
+	/**
+		@brief Accesso ai dati in lettura
+
+		Ritorna il valore dell'elemento in posizione (ii,jj), o il valore di
+		default se l'elemento non e' inserito.
+
+		@param ii indice della riga
+		@param jj indice della colonna
+
+		@return valore dell'elemento in posizione (ii,jj)
+
+		@throw index_out_of_bounds_exception
+	*/
+	const value_type& operator()(const sm_size ii, const sm_size jj) const {
+		if(ii >= _nRows || jj >= _nCols)
+			throw index_out_of_bounds_exception();
+
+		if(_size == 0)
+			return _D;
+
+		size_t pos = find(pack(ii, jj));
+		if(_keys[pos] == empty_key)
+			return _D;
+
+		return _values[pos];
+	}
+
+	/**
+		@brief riserva spazio per n elementi
+
+		Dimensiona la tabella in modo da contenere n elementi senza rehash.
+
+		@param n numero di elementi previsti
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	void reserve(const sm_size n){
+		size_t cap = 16;
+		while(cap < 2 * static_cast<size_t>(n))
+			cap *= 2;
+		if(cap > _keys.size())
+			rehash(cap);
+	}
+
+	/**
+		@brief Conversione nella forma ordinata
+
+		Crea una SparseMatrix con gli stessi elementi. Gli elementi vengono
+		raccolti e ordinati per chiave in O(n log n), poi la matrice viene
+		costruita con assign_sorted in una sola passata e una sola allocazione.
+
+		@return matrice sparsa ordinata equivalente
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	SparseMatrix<T> toSparseMatrix() const {
+		std::vector<std::tuple<sm_size, sm_size, value_type> > entries;
+		entries.reserve(_size);
+		for(size_t k = 0; k < _keys.size(); ++k)
+			if(_keys[k] != empty_key)
+				entries.push_back(std::make_tuple(static_cast<sm_size>(_keys[k] >> 32), static_cast<sm_size>(_keys[k]), _values[k]));
+
+		std::sort(entries.begin(), entries.end(), entry_less());
+
+		SparseMatrix<T> sm(_nRows, _nCols, _D);
+		sm.assign_sorted(entries.begin(), entries.end());
+		return sm;
+	}
+
+	/**
+		@brief numero di righe della matrice
+
+		@return numero di righe della matrice
+	*/
+	sm_size getNumRows() const {
+		return _nRows;
+	}
+
+	/**
+		@brief numero di colonne della matrice
+
+		@return numero di colonne della matrice
+	*/
+	sm_size getNumCols() const {
+		return _nCols;
+	}
+
+	/**
+		@brief numero di elementi inseriti nella matrice
+
+		@return numero di elementi inseriti
+	*/
+	sm_size getNumElement() const {
+		return _size;
+	}
+
+	/**
+		@brief valore di default della matrice
+
+		@return valore di default
+	*/
+	const value_type& getDefaultValue() const {
+		return _D;
+	}
+
+private:
+	typedef unsigned long long key_type; ///< coordinate (i,j) impacchettate
+
+	// nessuna coordinata valida ha tutti i bit a 1, quindi la uso per le celle vuote
+	static const key_type empty_key = ~0ULL;
+
+	std::vector<key_type> _keys; ///< chiavi della tabella, empty_key se la cella e' libera
+	std::vector<value_type> _values; ///< valori associati alle chiavi
+	value_type _D; ///< valore di default
+	sm_size _size; ///< numero di elementi inseriti
+	sm_size _nRows; ///< numero di righe
+	sm_size _nCols; ///< numero di colonne
+
+	/**
+		Funtore che confronta due elementi (i, j, valore) secondo l'ordine per
+		righe delle loro coordinate.
+
+		@brief ordinamento degli elementi
+	*/
+	struct entry_less {
+		bool operator()(const std::tuple<sm_size, sm_size, value_type> &a, const std::tuple<sm_size, sm_size, value_type> &b) const {
+			return std::get<0>(a) < std::get<0>(b) || (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b));
+		}
+	};
+
+	/**
+		@brief impacchetta le coordinate, la riga nei 32 bit alti
+
+		L'ordine delle chiavi coincide con l'ordine per righe delle coordinate.
+	*/
+	static key_type pack(const sm_size ii, const sm_size jj){
+		return (static_cast<key_type>(ii) << 32) | static_cast<key_type>(jj);
+	}
+
+	/**
+		@brief funzione hash (finalizzatore di splitmix64)
+	*/
+	static size_t hash(key_type k){
+		k ^= k >> 30;
+		k *= 0xbf58476d1ce4e5b9ULL;
+		k ^= k >> 27;
+		k *= 0x94d049bb133111ebULL;
+		k ^= k >> 31;
+		return static_cast<size_t>(k);
+	}
+
+	/**
+		Cerca la cella che contiene la chiave k oppure la prima cella libera
+		incontrata nella scansione. La tabella non deve essere vuota.
+
+		@brief ricerca di una chiave
+
+		@param keys tabella delle chiavi
+		@param k chiave da cercare
+		@return posizione della cella
+	*/
+	static size_t find(const std::vector<key_type> &keys, const key_type k){
+		const size_t mask = keys.size() - 1;
+		size_t pos = hash(k) & mask;
+		while(keys[pos] != k && keys[pos] != empty_key)
+			pos = (pos + 1) & mask;
+		return pos;
+	}
+
+	/**
+		@brief ricerca di una chiave nella tabella della matrice
+	*/
+	size_t find(const key_type k) const {
+		return find(_keys, k);
+	}
+
+	/**
+		@brief ridimensiona la tabella reinserendo tutti gli elementi
+
+		@param cap nuova capacita', potenza di 2
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	void rehash(const size_t cap){
+		std::vector<key_type> keys(cap, empty_key);
+		std::vector<value_type> values(cap, _D);
+
+		// riempio le nuove tabelle e le scambio solo alla fine, cosi' in caso
+		// di eccezione la matrice rimane invariata
+		for(size_t k = 0; k < _keys.size(); ++k){
+			if(_keys[k] != empty_key){
+				size_t pos = find(keys, _keys[k]);
+				keys[pos] = _keys[k];
+				values[pos] = _values[k];
+			}
+		}
+
+		keys.swap(_keys);
+		values.swap(_values);
+	}
+};
+
+template <typename T>
+const typename DokMatrix<T>::key_type DokMatrix<T>::empty_key;
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef MappedMatrix_H
+#define MappedMatrix_H
+
+#include <string>
+#include <iterator> // std::forward_iterator_tag
+#include <cstddef>  // std::ptrdiff_t
+#include <limits>
+#include <type_traits>
+#include <sys/mman.h>  // mmap, munmap
+#include <sys/stat.h>  // fstat
+#include <fcntl.h>  // open
+#include <unistd.h>  // close
+#include "SparseMatrix.h"
+
+/**
+	@file MappedMatrix.h
+	@brief Dichiarazione della classe templata MappedMatrix
+*/
+
+
+/**
+	Matrice sparsa in sola lettura servita direttamente da un file nel
+	formato binario di SparseMatrix::save (vedi sm_file_header), mappato in
+	memoria con mmap. L'apertura controlla soltanto l'intestazione, quindi
+	costa O(1) indipendentemente dal numero di elementi: le pagine del file
+	vengono caricate dal sistema operativo alla prima lettura.
+	Letture e iterazione leggono gli array del file senza copiarli.
+
+	@brief Matrice sparsa mappata da file
+
+	@param T tipo del dato, banalmente copiabile
+	@param I tipo delle coordinate usato nel file
+*/
+template <typename T, typename I = unsigned int>
+class MappedMatrix {
+	static_assert(std::is_trivially_copyable<T>::value, "MappedMatrix requires a trivially copyable T");
+
+public:
+	typedef I sm_size; ///< tipo delle coordinate
+	typedef std::size_t size_type; ///< tipo del numero di elementi
+	typedef T value_type; ///< tipo contenuto nella matrice
+	typedef typename SparseMatrix<T, std::allocator<T>, I>::element element; ///< elemento della matrice
+
+	/**
+		@brief Costruttore secondario
+
+		Mappa il file in memoria e ne controlla l'intestazione.
+
+		@param path percorso del file scritto da SparseMatrix::save
+
+		@throw matrix_file_exception se il file non puo' essere aperto o non e' nel formato atteso
+	*/
+	explicit MappedMatrix(const std::string &path) : _map(nullptr), _length(0) {
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0)
+			throw matrix_file_exception("Cannot open matrix file");
+
+		struct stat st;
+		if(::fstat(fd, &st) != 0 || static_cast<unsigned long long>(st.st_size) < sizeof(sm_file_header)){
+			::close(fd);
+			throw matrix_file_exception();
+		}
+
+		_length = static_cast<size_t>(st.st_size);
+		void *p = ::mmap(nullptr, _length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // la mappatura resta valida anche dopo la chiusura
+		if(p == MAP_FAILED)
+			throw matrix_file_exception("Cannot map matrix file");
+		_map = static_cast<const char*>(p);
+
+		const sm_file_header &h = *reinterpret_cast<const sm_file_header*>(_map);
+		if(!h.valid(sizeof(I), sizeof(T), _length) || h.rows > std::numeric_limits<I>::max() ||
+		   h.cols > std::numeric_limits<I>::max() || h.nnz > std::numeric_limits<size_type>::max()){
+			unmap();
+			throw matrix_file_exception();
+		}
+
+		_nRows = static_cast<sm_size>(h.rows);
+		_nCols = static_cast<sm_size>(h.cols);
+		_size = static_cast<size_type>(h.nnz);
+		_D = reinterpret_cast<const T*>(_map + h.defaultOffset);
+		_rows = reinterpret_cast<const I*>(_map + h.rowsOffset);
+		_cols = reinterpret_cast<const I*>(_map + h.colsOffset);
+		_values = reinterpret_cast<const T*>(_map + h.valuesOffset);
+	}
+
+	/**
+		@brief Distruttore, rilascia la mappatura
+	*/
+	~MappedMatrix(){
+		unmap();
+	}
+
+	MappedMatrix(const MappedMatrix &) = delete;
+	MappedMatrix& operator=(const MappedMatrix &) = delete;
+
+	/**
+		@brief Move constructor, prende la mappatura di other
+
+		@param other matrice da spostare, rimane senza mappatura
+	*/
+	MappedMatrix(MappedMatrix &&other) noexcept
+		: _map(other._map), _length(other._length), _D(other._D), _rows(other._rows), _cols(other._cols),
+		  _values(other._values), _nRows(other._nRows), _nCols(other._nCols), _size(other._size) {
+		other._map = nullptr;
+		other._length = 0;
+		other._size = 0;
+	}
+
+	/**
+		@brief Accesso ai dati in lettura
+
+		Cerca (ii,jj) con una ricerca binaria sugli array del file.
+
+		@param ii indice della riga
+		@param jj indice della colonna
+		@return valore dell'elemento in posizione (ii,jj)
+
+		@throw index_out_of_bounds_exception
+	*/
+	const value_type& operator()(const sm_size ii, const sm_size jj) const {
+		if(ii >= _nRows || jj >= _nCols)
+			throw index_out_of_bounds_exception();
+
+		size_type first = 0;
+		size_type count = _size;
+		while(count > 0){
+			const size_type step = count / 2;
+			const size_type k = first + step;
+			if(_rows[k] < ii || (_rows[k] == ii && _cols[k] < jj)){
+				first = k + 1;
+				count -= step + 1;
+			}
+			else
+				count = step;
+		}
+
+		if(first < _size && _rows[first] == ii && _cols[first] == jj)
+			return _values[first];
+
+		return *_D;
+	}
+
+	/**
+		@brief Copia in una SparseMatrix modificabile
+
+		Gli elementi del file sono gia' ordinati, quindi la matrice viene
+		costruita con assign_sorted, con una sola allocazione; un file con
+		elementi non ordinati viene rifiutato.
+
+		@return matrice sparsa con gli stessi elementi
+
+		@throw unsorted_range_exception se gli elementi del file non sono ordinati
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	SparseMatrix<T, std::allocator<T>, I> toSparseMatrix() const {
+		SparseMatrix<T, std::allocator<T>, I> sm(_nRows, _nCols, *_D);
+		sm.assign_sorted(begin(), end());
+		return sm;
+	}
+
+	/**
+		@brief numero di righe della matrice
+		@return numero di righe della matrice
+	*/
+	sm_size getNumRows() const {
+		return _nRows;
+	}
+
+	/**
+		@brief numero di colonne della matrice
+		@return numero di colonne della matrice
+	*/
+	sm_size getNumCols() const {
+		return _nCols;
+	}
+
+	/**
+		@brief numero di elementi inseriti nella matrice
+		@return numero di elementi inseriti
+	*/
+	size_type getNumElement() const {
+		return _size;
+	}
+
+	/**
+		@brief valore di default della matrice
+		@return valore di default
+	*/
+	const value_type& getDefaultValue() const {
+		return *_D;
+	}
+
+	/**
+		Iteratore costante della matrice mappata. Restituisce gli elementi
+		per valore, in ordine di riga, leggendoli dal file.
+
+		@brief Iteratore costante della matrice mappata
+	*/
+	class const_iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef element reference;
+
+		/**
+			Oggetto restituito da operator->, contiene una copia dell'elemento
+
+			@brief proxy per operator->
+		*/
+		struct pointer {
+			element e; ///< elemento puntato
+
+			/**
+				@brief accesso all'elemento
+				@return puntatore all'elemento
+			*/
+			const element* operator->() const {
+				return &e;
+			}
+		};
+
+		/**
+			Costruttore dell'iteratore costante
+			@brief Setta la matrice a nullptr
+		*/
+		const_iterator() : _m(nullptr), _k(0) {}
+
+		/**
+			@brief operatore di deferenziamento
+
+			@return struct element
+		*/
+		reference operator*() const {
+			return element(_m -> _rows[_k], _m -> _cols[_k], _m -> _values[_k]);
+		}
+
+		/**
+			@brief operatore ->
+
+			@return proxy che punta ad un element
+		*/
+		pointer operator->() const {
+			pointer p = { **this };
+			return p;
+		}
+
+		/**
+			@brief operatore di post-incremento
+
+			@return l'iteratore pre incremento
+		*/
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++_k;
+			return tmp;
+		}
+
+		/**
+			@brief operatore di pre-incremento
+
+			@return l'iteratore incrementato
+		*/
+		const_iterator& operator++() {
+			++_k;
+			return *this;
+		}
+
+		/**
+			@brief Operatore di uguaglianza
+
+			@param un altro const_iterator other
+			@return Risultato dell'uguaglianza
+		*/
+		bool operator==(const const_iterator &other) const {
+			return _m == other._m && _k == other._k;
+		}
+
+		/**
+			@brief Operatore di diseguaglianza
+
+			@param un altro const_iterator other
+			@return Risultato della diseguaglianza
+		*/
+		bool operator!=(const const_iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		const MappedMatrix *_m; ///< matrice su cui si itera
+		size_type _k; ///< posizione corrente negli array del file
+
+		friend class MappedMatrix;
+
+		const_iterator(const MappedMatrix *m, const size_type k) : _m(m), _k(k) {}
+	}; // classe const_iterator
+
+	/**
+		Ritorna l'iteratore all'inizio della sequenza dati
+
+		@return iteratore all'inizio della sequenza
+	*/
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	/**
+		Ritorna l'iteratore alla fine della sequenza dati
+
+		@return iteratore alla fine della sequenza
+	*/
+	const_iterator end() const {
+		return const_iterator(this, _size);
+	}
+
+private:
+	const char *_map; ///< inizio della mappatura del file
+	size_t _length; ///< lunghezza della mappatura
+	const T *_D; ///< valore di default, nel file
+	const I *_rows; ///< righe degli elementi, nel file
+	const I *_cols; ///< colonne degli elementi, nel file
+	const T *_values; ///< valori degli elementi, nel file
+	sm_size _nRows; ///< numero di righe
+	sm_size _nCols; ///< numero di colonne
+	size_type _size; ///< numero di elementi
+
+	/**
+		@brief rilascia la mappatura, se presente
+	*/
+	void unmap(){
+		if(_map != nullptr)
+			::munmap(const_cast<char*>(_map), _length);
+		_map = nullptr;
+	}
+};
+
+#endif
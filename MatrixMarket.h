@@ -0,0 +1,414 @@
+#ifndef MatrixMarket_H
+#define MatrixMarket_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <algorithm>  // std::transform, std::stable_sort, std::min
+#include <cctype>  // std::tolower
+#include <cstdio>  // std::snprintf
+#include <cstdlib>  // std::strtoull, std::strtod, std::strtoll
+#include <cstring>  // std::memchr
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <exception>  // std::exception_ptr
+#include "SparseMatrix.h"
+
+/**
+	@file MatrixMarket.h
+	@brief Lettura e scrittura di matrici sparse nel formato Matrix Market
+*/
+
+
+/**
+	Funzioni di supporto per il formato Matrix Market (solo formato
+	"coordinate").
+
+	@brief supporto al formato Matrix Market
+*/
+namespace matrix_market_detail {
+
+/**
+	@brief descrizione della riga di intestazione %%MatrixMarket
+*/
+struct banner {
+	bool pattern; ///< campo "pattern": nessun valore, ogni elemento vale T(1)
+	bool integer; ///< campo "integer"
+	bool symmetric; ///< simmetria "symmetric"
+	bool skew; ///< simmetria "skew-symmetric"
+};
+
+/**
+	@brief legge la riga di intestazione
+
+	@param line prima riga del file
+	@return descrizione dell'intestazione
+
+	@throw matrix_file_exception se l'intestazione non e' supportata
+*/
+inline banner parse_banner(std::string line){
+	std::transform(line.begin(), line.end(), line.begin(), [](char c){ return static_cast<char>(std::tolower(c)); });
+
+	std::istringstream in(line);
+	std::string tag, object, format, field, symmetry;
+	in >> tag >> object >> format >> field >> symmetry;
+
+	if(tag != "%%matrixmarket" || object != "matrix")
+		throw matrix_file_exception("Not a Matrix Market file");
+	if(format != "coordinate")
+		throw matrix_file_exception("Only the Matrix Market coordinate format is supported");
+	if(field != "real" && field != "double" && field != "integer" && field != "pattern")
+		throw matrix_file_exception("Unsupported Matrix Market field");
+	if(symmetry != "general" && symmetry != "symmetric" && symmetry != "skew-symmetric")
+		throw matrix_file_exception("Unsupported Matrix Market symmetry");
+
+	banner b;
+	b.pattern = field == "pattern";
+	b.integer = field == "integer";
+	b.symmetric = symmetry == "symmetric";
+	b.skew = symmetry == "skew-symmetric";
+	return b;
+}
+
+/**
+	@brief salta spazi e tabulazioni
+*/
+inline const char *skip_blanks(const char *p, const char *end){
+	while(p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		++p;
+	return p;
+}
+
+/**
+	Analizza le righe di [first, last), che deve terminare con '\n', e
+	accoda le terne in out (indici gia' convertiti a base 0 e controllati
+	rispetto a rows x cols). Per le matrici simmetriche aggiunge anche
+	l'elemento speculare fuori diagonale.
+	Il buffer deve continuare dopo last fino a un carattere nullo.
+
+	@brief analisi di un blocco di righe
+
+	@return numero di elementi letti dal file
+
+	@throw matrix_file_exception se una riga non e' valida
+	@throw index_out_of_bounds_exception se un elemento e' fuori dalla matrice
+*/
+template <typename T>
+unsigned long long parse_block(const char *first, const char *last, const banner &b,
+                 const unsigned long long rows, const unsigned long long cols,
+                 std::vector<std::tuple<unsigned long long, unsigned long long, T> > &out){
+	unsigned long long count = 0;
+	while(first < last){
+		const char *eol = static_cast<const char*>(std::memchr(first, '\n', last - first));
+		const char *p = skip_blanks(first, eol);
+		first = eol + 1;
+
+		if(p == eol || *p == '%')
+			continue; // riga vuota o commento
+
+		char *next;
+		const unsigned long long i = std::strtoull(p, &next, 10);
+		if(next == p || next > eol)
+			throw matrix_file_exception("Malformed Matrix Market entry");
+		p = next;
+		const unsigned long long j = std::strtoull(p, &next, 10);
+		if(next == p || next > eol)
+			throw matrix_file_exception("Malformed Matrix Market entry");
+		p = next;
+
+		T v = T(1);
+		if(!b.pattern){
+			if(b.integer)
+				v = static_cast<T>(std::strtoll(p, &next, 10));
+			else
+				v = static_cast<T>(std::strtod(p, &next));
+			if(next == p || next > eol)
+				throw matrix_file_exception("Malformed Matrix Market entry");
+		}
+
+		// gli indici sono in base 1: lo 0 diventa un indice enorme e viene scartato dal controllo dei limiti
+		if(i - 1 >= rows || j - 1 >= cols)
+			throw index_out_of_bounds_exception();
+		out.push_back(std::make_tuple(i - 1, j - 1, v));
+		if((b.symmetric || b.skew) && i != j)
+			out.push_back(std::make_tuple(j - 1, i - 1, b.skew ? static_cast<T>(-v) : v));
+		++count;
+	}
+
+	return count;
+}
+
+/**
+	Ordina le terne per (i,j) e unisce sul posto quelle con le stesse
+	coordinate, nell'ordine del file: con sum somma i valori, altrimenti
+	tiene l'ultimo. Le terne distinte sono le prime n del vettore.
+
+	@brief ordinamento e unione dei duplicati sul posto
+
+	@return numero n di terne distinte
+
+	@throw eccezione di allocazione di memoria (runtime)
+*/
+template <typename T>
+size_t unique_entries(std::vector<std::tuple<unsigned long long, unsigned long long, T> > &e, const bool sum){
+	typedef std::tuple<unsigned long long, unsigned long long, T> entry;
+
+	// stabile: a parita' di coordinate resta l'ordine del file
+	std::stable_sort(e.begin(), e.end(), [](const entry &a, const entry &b){
+		return std::get<0>(a) < std::get<0>(b) || (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b));
+	});
+
+	size_t n = 0;
+	for(size_t k = 0; k < e.size(); ++k){
+		if(n > 0 && std::get<0>(e[n - 1]) == std::get<0>(e[k]) && std::get<1>(e[n - 1]) == std::get<1>(e[k])){
+			if(sum)
+				std::get<2>(e[n - 1]) = std::get<2>(e[n - 1]) + std::get<2>(e[k]);
+			else
+				std::get<2>(e[n - 1]) = std::get<2>(e[k]);
+		}
+		else{
+			if(n != k)
+				e[n] = e[k];
+			++n;
+		}
+	}
+
+	return n;
+}
+
+/**
+	@brief prodotto a 64 bit, saturato al massimo invece di andare in overflow
+*/
+inline unsigned long long saturated_product(const unsigned long long a, const unsigned long long b){
+	if(a != 0 && b > std::numeric_limits<unsigned long long>::max() / a)
+		return std::numeric_limits<unsigned long long>::max();
+	return a * b;
+}
+
+/**
+	@brief scrive un valore intero
+*/
+template <typename T>
+int format_value(char *buf, const size_t n, const T &v, std::true_type, std::false_type){
+	return std::is_signed<T>::value ? std::snprintf(buf, n, "%lld", static_cast<long long>(v))
+	                                : std::snprintf(buf, n, "%llu", static_cast<unsigned long long>(v));
+}
+
+/**
+	@brief scrive un valore in virgola mobile senza perdita di precisione
+*/
+template <typename T>
+int format_value(char *buf, const size_t n, const T &v, std::false_type, std::true_type){
+	return std::snprintf(buf, n, "%.17g", static_cast<double>(v));
+}
+
+} // namespace matrix_market_detail
+
+/**
+	@brief Lettura di un file Matrix Market
+
+	Legge un file Matrix Market in formato coordinate (campi real, integer
+	o pattern; simmetria general, symmetric o skew-symmetric). Il file viene
+	letto a blocchi di chunkSize byte: ogni blocco viene diviso in parti che
+	terminano a fine riga, analizzate in parallelo da threads thread. Le
+	terne lette vengono ordinate e unite sul posto, poi l'array della matrice
+	viene costruito da esse con assign_sorted (una sola allocazione), mai con add.
+	La memoria usata e' quella delle terne (al massimo quelle dichiarate
+	nella riga delle dimensioni, piu' un blocco), il buffer temporaneo
+	dell'ordinamento stabile (fino a meta' delle terne) e, solo alla fine,
+	la matrice costruita. La riga delle dimensioni non viene usata per
+	riservare piu' memoria di quella di un blocco: un numero di elementi
+	enorme o sbagliato non causa allocazioni prima di leggere le righe.
+	Il formato non memorizza il valore di default, che va passato.
+
+	@param path percorso del file
+	@param dv valore di default della matrice
+	@param threads numero di thread, 0 per un thread per core
+	@param policy politica per le coordinate duplicate
+	@param chunkSize dimensione dei blocchi letti dal file
+	@return matrice letta
+
+	@throw matrix_file_exception se il file non puo' essere letto o non e' valido
+	@throw index_out_of_bounds_exception se un elemento e' fuori dalla matrice
+	@throw eccezione di allocazione di memoria (runtime)
+*/
+template <typename T, typename I = unsigned int>
+SparseMatrix<T, std::allocator<T>, I> read_matrix_market(const std::string &path, const T &dv = T(), unsigned int threads = 0,
+                                                         const typename SparseMatrix<T, std::allocator<T>, I>::duplicate_policy policy =
+                                                             SparseMatrix<T, std::allocator<T>, I>::last_wins,
+                                                         const size_t chunkSize = 1 << 24){
+	typedef std::tuple<unsigned long long, unsigned long long, T> entry;
+	typedef SparseMatrix<T, std::allocator<T>, I> matrix;
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if(!in)
+		throw matrix_file_exception("Cannot open Matrix Market file");
+
+	std::string line;
+	if(!std::getline(in, line))
+		throw matrix_file_exception("Not a Matrix Market file");
+	const matrix_market_detail::banner b = matrix_market_detail::parse_banner(line);
+
+	// commenti, poi la riga delle dimensioni
+	do{
+		if(!std::getline(in, line))
+			throw matrix_file_exception("Missing Matrix Market size line");
+	} while(line.empty() || line[0] == '%' || line.find_first_not_of(" \t\r") == std::string::npos);
+
+	unsigned long long rows = 0, cols = 0, nnz = 0;
+	std::istringstream size(line);
+	if(!(size >> rows >> cols >> nnz))
+		throw matrix_file_exception("Malformed Matrix Market size line");
+	if(rows > std::numeric_limits<I>::max() || cols > std::numeric_limits<I>::max())
+		throw matrix_file_exception("Matrix Market dimensions do not fit the index type");
+
+	if(threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if(threads == 0)
+		threads = 1;
+
+	// terne attese, ma al piu' quelle di un blocco (ogni riga ha almeno "i j\n"): il vettore cresce se servono
+	const unsigned long long mirror = (b.symmetric || b.skew) ? 2 : 1;
+	const unsigned long long expected = std::min(matrix_market_detail::saturated_product(nnz, mirror),
+	                                             matrix_market_detail::saturated_product(rows, cols));
+	std::vector<entry> entries;
+	entries.reserve(static_cast<size_t>(std::min(expected, (chunkSize / 4 + 1) * mirror)));
+	unsigned long long read = 0;
+
+	std::vector<char> buffer;
+	std::vector<std::vector<entry> > parts(threads);
+	std::vector<unsigned long long> counts(threads);
+	std::vector<std::exception_ptr> errors(threads);
+	size_t carry = 0; // byte dell'ultima riga incompleta del blocco precedente
+
+	while(true){
+		buffer.resize(carry + chunkSize + 1);
+		in.read(buffer.data() + carry, static_cast<std::streamsize>(chunkSize));
+		size_t length = carry + static_cast<size_t>(in.gcount());
+		const bool eof = !in;
+
+		if(eof && (length == 0 || buffer[length - 1] != '\n'))
+			buffer[length++] = '\n'; // l'ultima riga puo' non terminare con '\n'
+		buffer[length] = '\0'; // ferma strtoull e strtod alla fine del blocco
+
+		// fine dell'ultima riga completa del blocco
+		size_t complete = length;
+		while(complete > 0 && buffer[complete - 1] != '\n')
+			--complete;
+
+		// divido le righe complete in parti che terminano a fine riga, una per thread
+		std::vector<size_t> bounds(threads + 1, complete);
+		bounds[0] = 0;
+		for(unsigned int t = 1; t < threads; ++t){
+			size_t k = std::max(bounds[t - 1], complete * t / threads);
+			while(k < complete && k > 0 && buffer[k - 1] != '\n')
+				++k;
+			bounds[t] = k;
+		}
+
+		const char *data = buffer.data();
+		run_parallel(threads, [&](const unsigned int t){
+			try{
+				parts[t].clear();
+				counts[t] = matrix_market_detail::parse_block<T>(data + bounds[t], data + bounds[t + 1], b, rows, cols, parts[t]);
+			}
+			catch(...){
+				errors[t] = std::current_exception();
+			}
+		});
+
+		for(unsigned int t = 0; t < threads; ++t){
+			if(errors[t])
+				std::rethrow_exception(errors[t]);
+			read += counts[t];
+		}
+		if(read > nnz)
+			throw matrix_file_exception("Matrix Market entry count does not match the size line");
+		for(unsigned int t = 0; t < threads; ++t)
+			entries.insert(entries.end(), parts[t].begin(), parts[t].end());
+
+		if(eof)
+			break;
+
+		// la riga incompleta passa al blocco successivo (se e' piu' lunga del blocco, il buffer cresce)
+		carry = length - complete;
+		std::copy(buffer.begin() + complete, buffer.begin() + length, buffer.begin());
+	}
+
+	if(read != nnz)
+		throw matrix_file_exception("Matrix Market entry count does not match the size line");
+
+	const size_t n = matrix_market_detail::unique_entries(entries, policy == matrix::sum);
+	matrix sm(static_cast<I>(rows), static_cast<I>(cols), dv);
+	sm.assign_sorted(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(n));
+	return sm;
+}
+
+/**
+	@brief Scrittura in formato Matrix Market
+
+	Scrive la matrice in formato coordinate general, campo integer per T
+	intero e real altrimenti, leggendo gli elementi con il const_iterator.
+	Le righe vengono accumulate in un buffer e scritte a blocchi. Il valore
+	di default non fa parte del formato e non viene scritto.
+
+	@param sm matrice da scrivere
+	@param out stream di uscita
+
+	@throw matrix_file_exception se la scrittura fallisce
+*/
+template <typename T, typename A, typename I, typename S>
+void write_matrix_market(const SparseMatrix<T, A, I, S> &sm, std::ostream &out){
+	static_assert(std::is_arithmetic<T>::value, "write_matrix_market requires an arithmetic T");
+	typedef std::integral_constant<bool, std::is_integral<T>::value> integral;
+	typedef std::integral_constant<bool, std::is_floating_point<T>::value> floating;
+
+	out << "%%MatrixMarket matrix coordinate " << (integral::value ? "integer" : "real") << " general\n"
+	    << sm.getNumRows() << ' ' << sm.getNumCols() << ' ' << sm.getNumElement() << '\n';
+
+	const size_t flushAt = 1 << 20;
+	std::string buffer;
+	buffer.reserve(flushAt + 128);
+	char line[128];
+
+	for(typename SparseMatrix<T, A, I, S>::const_iterator i = sm.begin(), ie = sm.end(); i != ie; ++i){
+		int n = std::snprintf(line, sizeof(line), "%llu %llu ", static_cast<unsigned long long>(i -> i) + 1,
+		                      static_cast<unsigned long long>(i -> j) + 1);
+		n += matrix_market_detail::format_value(line + n, sizeof(line) - n, i -> value, integral(), floating());
+		buffer.append(line, n);
+		buffer.push_back('\n');
+
+		if(buffer.size() >= flushAt){
+			out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			buffer.clear();
+		}
+	}
+	out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+	if(!out)
+		throw matrix_file_exception("Cannot write Matrix Market file");
+}
+
+/**
+	@brief Scrittura in formato Matrix Market su file
+
+	@param sm matrice da scrivere
+	@param path percorso del file (sovrascritto se esiste)
+
+	@throw matrix_file_exception se il file non puo' essere scritto
+*/
+template <typename T, typename A, typename I, typename S>
+void write_matrix_market(const SparseMatrix<T, A, I, S> &sm, const std::string &path){
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	if(!out)
+		throw matrix_file_exception("Cannot open Matrix Market file for writing");
+	write_matrix_market(sm, static_cast<std::ostream&>(out));
+	out.flush();
+	if(!out)
+		throw matrix_file_exception("Cannot write Matrix Market file");
+}
+
+#endif
@@ -0,0 +1,361 @@
+#ifndef SnapshotMatrix_H
+#define SnapshotMatrix_H
+
+#include <atomic>
+#include <memory>  // std::unique_ptr
+#include <mutex>
+#include <new>  // std::bad_alloc
+#include <cstdlib>  // posix_memalign, std::free
+#include <utility>  // std::move
+#include <vector>
+#include "SparseMatrix.h"
+
+/**
+	@file SnapshotMatrix.h
+	@brief Dichiarazione della classe templata SnapshotMatrix
+*/
+
+
+/**
+	Matrice sparsa pubblicata per versioni immutabili, nello stile RCU
+	(read-copy-update). I lettori prendono con snapshot() la versione
+	corrente e possono usarla quanto vogliono anche mentre vengono
+	pubblicate versioni piu' nuove. Gli scrittori costruiscono una nuova
+	versione a partire da una copia di quella corrente e la pubblicano
+	scambiando un puntatore atomico.
+
+	La lettura non usa lock ne' contatori di riferimenti condivisi: ogni
+	lettore occupa un proprio record (hazard pointer), allineato a 64 byte,
+	in cui annuncia la versione che sta usando. Prendere una versione costa
+	la ricerca di un record libero, con un compare-and-swap sul record,
+	una scrittura e una rilettura del puntatore corrente; un nuovo record
+	viene allocato solo quando ci sono piu' versioni in uso contemporaneamente
+	che record creati fino a quel momento.
+
+	Gli scrittori sono serializzati tra loro da un mutex, che i lettori non
+	usano mai. Una versione sostituita viene distrutta dallo scrittore, alla
+	prima pubblicazione o chiamata a reclaim() in cui nessun record la
+	annuncia piu'. Le versioni restituite da snapshot() non devono
+	sopravvivere alla SnapshotMatrix.
+
+	@brief Matrice sparsa con letture per versioni
+
+	@param T tipo del dato
+	@param A allocatore
+	@param I tipo delle coordinate
+	@param S politica di strumentazione
+*/
+template <typename T, typename A = std::allocator<T>, typename I = unsigned int, typename S = no_instrumentation>
+class SnapshotMatrix {
+
+	struct reader_slot;
+
+public:
+	typedef SparseMatrix<T, A, I, S> matrix_type; ///< tipo di una versione
+	typedef std::size_t size_type; ///< tipo del numero di versioni
+
+	/**
+		Versione immutabile in uso da un lettore. Finche' esiste la versione
+		non viene distrutta; puo' essere spostata ma non copiata, perche'
+		occupa un record del lettore.
+
+		@brief versione in lettura
+	*/
+	class snapshot_type {
+	public:
+		/**
+			Costruttore di default
+			@brief nessuna versione
+		*/
+		snapshot_type() : _p(nullptr), _slot(nullptr) {}
+
+		snapshot_type(snapshot_type &&other) noexcept : _p(other._p), _slot(other._slot) {
+			other._p = nullptr;
+			other._slot = nullptr;
+		}
+
+		snapshot_type& operator=(snapshot_type &&other) noexcept {
+			if(this != &other){
+				reset();
+				_p = other._p;
+				_slot = other._slot;
+				other._p = nullptr;
+				other._slot = nullptr;
+			}
+			return *this;
+		}
+
+		snapshot_type(const snapshot_type &) = delete;
+		snapshot_type& operator=(const snapshot_type &) = delete;
+
+		~snapshot_type(){
+			reset();
+		}
+
+		/**
+			@brief accesso alla versione
+			@return riferimento costante alla matrice
+		*/
+		const matrix_type& operator*() const {
+			return *_p;
+		}
+
+		/**
+			@brief accesso alla versione
+			@return puntatore costante alla matrice
+		*/
+		const matrix_type* operator->() const {
+			return _p;
+		}
+
+		/**
+			@brief versione in uso
+			@return puntatore alla matrice, nullptr se non c'e' una versione
+		*/
+		const matrix_type* get() const {
+			return _p;
+		}
+
+		/**
+			@brief true se c'e' una versione in uso
+		*/
+		explicit operator bool() const {
+			return _p != nullptr;
+		}
+
+		/**
+			Rilascia la versione e il record del lettore: da questo momento lo
+			scrittore puo' distruggerla, se e' stata sostituita.
+
+			@brief rilascio della versione
+		*/
+		void reset() noexcept {
+			if(_slot != nullptr){
+				_slot -> hazard.store(nullptr, std::memory_order_release);
+				_slot -> active.store(false, std::memory_order_release);
+			}
+			_p = nullptr;
+			_slot = nullptr;
+		}
+
+	private:
+		const matrix_type *_p; ///< versione in uso
+		reader_slot *_slot; ///< record del lettore che la annuncia
+
+		friend class SnapshotMatrix;
+
+		snapshot_type(const matrix_type *p, reader_slot *slot) : _p(p), _slot(slot) {}
+	};
+
+	/**
+		@brief Costruttore secondario
+
+		@param m prima versione della matrice
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	explicit SnapshotMatrix(matrix_type m) : _current(new matrix_type(std::move(m))), _readers(nullptr) {}
+
+	SnapshotMatrix(const SnapshotMatrix &) = delete;
+	SnapshotMatrix& operator=(const SnapshotMatrix &) = delete;
+
+	/**
+		@brief Distruttore
+
+		Distrugge tutte le versioni e i record dei lettori: nessuna versione
+		restituita da snapshot() deve essere ancora in uso.
+	*/
+	~SnapshotMatrix(){
+		delete _current.load(std::memory_order_relaxed);
+		for(size_type k = 0; k < _retired.size(); ++k)
+			delete _retired[k];
+
+		reader_slot *s = _readers.load(std::memory_order_relaxed);
+		while(s != nullptr){
+			reader_slot *next = s -> next;
+			delete s;
+			s = next;
+		}
+	}
+
+	/**
+		@brief Versione corrente
+
+		Non usa lock: annuncia la versione nel record del lettore e rilegge
+		il puntatore corrente per essere sicura che non sia stata sostituita
+		nel frattempo. La versione restituita resta valida e immutabile anche
+		dopo la pubblicazione di versioni successive.
+
+		@return versione corrente
+
+		@throw eccezione di allocazione di memoria (runtime), solo se serve un nuovo record
+	*/
+	snapshot_type snapshot() const {
+		reader_slot *slot = acquire_slot();
+
+		const matrix_type *p = _current.load(std::memory_order_seq_cst);
+		while(true){
+			slot -> hazard.store(p, std::memory_order_seq_cst);
+			const matrix_type *q = _current.load(std::memory_order_seq_cst);
+			if(q == p)
+				break;
+			p = q;
+		}
+
+		return snapshot_type(p, slot);
+	}
+
+	/**
+		@brief Pubblicazione di una nuova versione
+
+		Sostituisce la versione corrente con m. I lettori che hanno gia' una
+		versione continuano a usarla; le versioni sostituite che nessun
+		lettore usa vengono distrutte.
+
+		@param m nuova versione
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	void publish(matrix_type m){
+		std::unique_ptr<const matrix_type> next(new matrix_type(std::move(m)));
+		std::lock_guard<std::mutex> lock(_writer);
+		replace(next);
+	}
+
+	/**
+		@brief Modifica della matrice
+
+		Copia la versione corrente, chiama f sulla copia e pubblica il
+		risultato. Gli scrittori sono serializzati, quindi nessuna modifica
+		viene persa; se f lancia un'eccezione la versione corrente non cambia.
+
+		@param f funzione che riceve un matrix_type& da modificare
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	template <typename F>
+	void update(F f){
+		std::lock_guard<std::mutex> lock(_writer);
+		std::unique_ptr<matrix_type> copy(new matrix_type(*_current.load(std::memory_order_relaxed)));
+		f(*copy);
+		std::unique_ptr<const matrix_type> next(copy.release());
+		replace(next);
+	}
+
+	/**
+		@brief Distruzione delle versioni non piu' usate
+
+		Distrugge le versioni sostituite che nessun lettore usa piu', senza
+		aspettare la prossima pubblicazione.
+
+		@return numero di versioni sostituite ancora in uso da qualche lettore
+	*/
+	size_type reclaim(){
+		std::lock_guard<std::mutex> lock(_writer);
+		collect();
+		return _retired.size();
+	}
+
+private:
+	/**
+		Record di un lettore, allineato a 64 byte perche' lettori diversi
+		scrivano su linee di cache diverse. I record formano una lista a cui
+		si aggiunge in testa senza lock e vengono riusati, liberati solo dal
+		distruttore.
+
+		@brief record di un lettore
+	*/
+	struct alignas(64) reader_slot {
+		std::atomic<const matrix_type*> hazard; ///< versione in uso, nullptr se nessuna
+		std::atomic<bool> active; ///< true se il record e' occupato da un lettore
+		reader_slot *next; ///< record successivo della lista
+
+		reader_slot() : hazard(nullptr), active(true), next(nullptr) {}
+
+		static void* operator new(const std::size_t n){
+			void *p = nullptr;
+			if(posix_memalign(&p, alignof(reader_slot), n) != 0)
+				throw std::bad_alloc();
+			return p;
+		}
+
+		static void operator delete(void *p){
+			std::free(p);
+		}
+	};
+
+	std::atomic<const matrix_type*> _current; ///< versione corrente
+	mutable std::atomic<reader_slot*> _readers; ///< testa della lista dei record dei lettori
+	std::vector<const matrix_type*> _retired; ///< versioni sostituite ancora in uso, protette da _writer
+	std::mutex _writer; ///< serializza gli scrittori
+
+	/**
+		Il nuovo record viene aggiunto con un compare-and-swap seq_cst, come
+		l'annuncio in snapshot() e la lettura della lista in in_use(): con
+		release/acquire lo scrittore potrebbe leggere la vecchia testa della
+		lista dopo lo scambio della versione e distruggere una versione che il
+		lettore sta annunciando nel nuovo record.
+
+		@brief occupa un record libero, o ne aggiunge uno in testa alla lista
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	reader_slot* acquire_slot() const {
+		for(reader_slot *s = _readers.load(std::memory_order_seq_cst); s != nullptr; s = s -> next){
+			bool expected = false;
+			if(!s -> active.load(std::memory_order_relaxed) &&
+			   s -> active.compare_exchange_strong(expected, true, std::memory_order_acquire))
+				return s;
+		}
+
+		reader_slot *s = new reader_slot();
+		reader_slot *head = _readers.load(std::memory_order_relaxed);
+		do{
+			s -> next = head;
+		} while(!_readers.compare_exchange_weak(head, s, std::memory_order_seq_cst, std::memory_order_relaxed));
+		return s;
+	}
+
+	/**
+		Pubblica next e mette da parte la versione sostituita. Va chiamata
+		con _writer bloccato.
+
+		@brief scambio della versione corrente
+
+		@throw eccezione di allocazione di memoria (runtime), prima dello scambio
+	*/
+	void replace(std::unique_ptr<const matrix_type> &next){
+		_retired.reserve(_retired.size() + 1); // dopo lo scambio push_back non puo' fallire
+		_retired.push_back(_current.exchange(next.release(), std::memory_order_seq_cst));
+		collect();
+	}
+
+	/**
+		Distrugge le versioni sostituite che nessun record annuncia. Va
+		chiamata con _writer bloccato.
+
+		@brief distruzione delle versioni non usate
+	*/
+	void collect(){
+		size_type kept = 0;
+		for(size_type k = 0; k < _retired.size(); ++k){
+			if(in_use(_retired[k]))
+				_retired[kept++] = _retired[k];
+			else
+				delete _retired[k];
+		}
+		_retired.resize(kept);
+	}
+
+	/**
+		@brief true se un lettore annuncia la versione p
+	*/
+	bool in_use(const matrix_type *p) const {
+		for(reader_slot *s = _readers.load(std::memory_order_seq_cst); s != nullptr; s = s -> next)
+			if(s -> hazard.load(std::memory_order_seq_cst) == p)
+				return true;
+		return false;
+	}
+};
+
+#endif
@@ -2,9 +2,27 @@
 #define SparseMatrix_H
 
 #include <algorithm>  // std::swap
-#include <iostream>
 #include <iterator> // std::forward_iterator_tag
 #include <cstddef>  // std::ptrdiff_t
+#include <memory>  // std::allocator, std::allocator_traits
+#include <stdexcept>  // std::logic_error, std::overflow_error
+#include <limits>  // std::numeric_limits
+#include <vector>
+#include <tuple>
+#include <type_traits>  // std::true_type, std::false_type
+#include <thread>
+#include <exception>  // std::exception_ptr
+#include <functional>  // std::plus, std::minus, std::multiplies
+#include <atomic>
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstring>  // std::memcmp
+#include <fstream>
+#include <string>
+#include <utility>  // std::pair
+#include "SpmvKernels.h"
+#if __cplusplus >= 201703L
+#include <memory_resource>  // std::pmr::polymorphic_allocator
+#endif
 
 /**
 	@file SparseMatrix.h 
@@ -27,23 +45,389 @@ public:
     index_out_of_bounds_exception() : std::logic_error("Index i or j out of bounds") {}
 };
 
+/**
+	Classe eccezione custom che deriva da std::logic_error
+	Viene generata quando le dimensioni degli operandi di un'operazione
+	non sono compatibili.
+
+	@brief dimension mismatch exception
+*/
+class dimension_mismatch_exception : public std::logic_error {
+public:
+	/**
+		Costruttore di default 
+	*/
+    dimension_mismatch_exception() : std::logic_error("Operand dimensions do not match") {}
+};
+
+/**
+	Classe eccezione custom che deriva da std::logic_error
+	Viene generata dalle operazioni che richiedono un valore di default
+	nullo (T()) quando una matrice ha un valore di default diverso.
+
+	@brief default value exception
+*/
+class default_value_exception : public std::logic_error {
+public:
+	/**
+		Costruttore di default 
+	*/
+    default_value_exception() : std::logic_error("Operation requires a zero default value") {}
+};
+
+/**
+	Classe eccezione custom che deriva da std::logic_error
+	Viene generata dagli inserimenti di massa che richiedono elementi
+	ordinati per coordinate e senza duplicati quando l'intervallo non lo e'.
+
+	@brief unsorted range exception
+*/
+class unsorted_range_exception : public std::logic_error {
+public:
+	/**
+		Costruttore di default 
+	*/
+    unsorted_range_exception() : std::logic_error("Range is not sorted by (i,j) or has duplicates") {}
+};
+
+/**
+	Classe eccezione custom che deriva da std::runtime_error
+	Viene generata quando un file di una matrice non puo' essere letto o
+	scritto, oppure non e' nel formato atteso.
+
+	@brief matrix file exception
+*/
+class matrix_file_exception : public std::runtime_error {
+public:
+	/**
+		Costruttore con messaggio
+
+		@param what descrizione dell'errore
+	*/
+    explicit matrix_file_exception(const char *what = "Invalid matrix file") : std::runtime_error(what) {}
+};
+
+/**
+	Intestazione del formato binario delle matrici (versione 1), scritto da
+	SparseMatrix::save e letto da MappedMatrix. Dopo l'intestazione il file
+	contiene, ognuno allineato a 64 byte: il valore di default, l'array delle
+	righe e quello delle colonne (indexWidth byte per indice) e l'array dei
+	valori (valueSize byte per valore), nell'ordine per righe della matrice.
+	Tutti i numeri sono nell'ordine dei byte della macchina che ha scritto
+	il file, verificato con il campo endian.
+
+	@brief intestazione del file binario
+*/
+struct sm_file_header {
+	char magic[8]; ///< "SPMXBIN" terminato da zero
+	uint32_t version; ///< versione del formato
+	uint32_t endian; ///< 0x01020304 nell'ordine dei byte di chi ha scritto il file
+	uint32_t indexWidth; ///< byte di ogni indice
+	uint32_t valueSize; ///< byte di ogni valore
+	uint64_t rows; ///< numero di righe
+	uint64_t cols; ///< numero di colonne
+	uint64_t nnz; ///< numero di elementi inseriti
+	uint64_t defaultOffset; ///< posizione del valore di default
+	uint64_t rowsOffset; ///< posizione dell'array delle righe
+	uint64_t colsOffset; ///< posizione dell'array delle colonne
+	uint64_t valuesOffset; ///< posizione dell'array dei valori
+	uint64_t fileSize; ///< dimensione totale del file
+
+	static const uint32_t current_version = 1; ///< versione scritta da save
+	static const uint32_t endian_mark = 0x01020304u; ///< valore del campo endian
+	static const uint64_t alignment = 64; ///< allineamento di ogni sezione
+
+	/**
+		@brief arrotonda n al multiplo di alignment successivo
+	*/
+	static uint64_t align(const uint64_t n){
+		return (n + alignment - 1) / alignment * alignment;
+	}
+
+	/**
+		@brief intestazione con dimensioni e posizioni delle sezioni
+
+		@param indexBytes byte di ogni indice
+		@param valueBytes byte di ogni valore
+		@param r numero di righe
+		@param c numero di colonne
+		@param n numero di elementi
+		@return intestazione completa
+	*/
+	static sm_file_header make(const uint32_t indexBytes, const uint32_t valueBytes,
+	                           const uint64_t r, const uint64_t c, const uint64_t n){
+		sm_file_header h;
+		std::memset(&h, 0, sizeof(h));
+		std::memcpy(h.magic, "SPMXBIN", 8);
+		h.version = current_version;
+		h.endian = endian_mark;
+		h.indexWidth = indexBytes;
+		h.valueSize = valueBytes;
+		h.rows = r;
+		h.cols = c;
+		h.nnz = n;
+		h.defaultOffset = align(sizeof(sm_file_header));
+		h.rowsOffset = align(h.defaultOffset + valueBytes);
+		h.colsOffset = align(h.rowsOffset + n * indexBytes);
+		h.valuesOffset = align(h.colsOffset + n * indexBytes);
+		h.fileSize = h.valuesOffset + n * valueBytes;
+		return h;
+	}
+
+	/**
+		@brief controlla che l'intestazione sia valida per indici e valori dati
+
+		@param indexBytes byte attesi per ogni indice
+		@param valueBytes byte attesi per ogni valore
+		@param length dimensione del file
+		@return true se l'intestazione e' coerente e descrive un file di length byte
+	*/
+	bool valid(const uint32_t indexBytes, const uint32_t valueBytes, const uint64_t length) const {
+		if(std::memcmp(magic, "SPMXBIN", 8) != 0 || version != current_version || endian != endian_mark ||
+		   indexWidth != indexBytes || valueSize != valueBytes || fileSize != length)
+			return false;
+
+		// nnz non puo' superare le celle ne' far traboccare le posizioni
+		if(nnz > length || (nnz != 0 && (rows == 0 || (nnz - 1) / rows >= cols)))
+			return false;
+
+		const sm_file_header expected = make(indexBytes, valueBytes, rows, cols, nnz);
+		return defaultOffset == expected.defaultOffset && rowsOffset == expected.rowsOffset &&
+		       colsOffset == expected.colsOffset && valuesOffset == expected.valuesOffset &&
+		       fileSize == expected.fileSize;
+	}
+};
+
+/**
+	Statistiche raccolte da counting_instrumentation.
+
+	@brief statistiche di una matrice sparsa
+*/
+struct sm_stats {
+	unsigned long long allocations; ///< allocazioni dell'array degli elementi
+	unsigned long long allocated; ///< elementi allocati in totale
+	unsigned long long lookups; ///< letture con operator()
+	unsigned long long lookupSteps; ///< passi della ricerca binaria nelle letture
+	unsigned long long inserts; ///< nuovi elementi inseriti con add
+	unsigned long long overwrites; ///< add su celle gia' inserite
+	unsigned long long insertSteps; ///< passi della ricerca binaria negli add
+	unsigned long long shifted; ///< elementi spostati per inserire in mezzo all'array
+	unsigned long long copied; ///< elementi copiati (copie della matrice e riallocazioni)
+
+	sm_stats() : allocations(0), allocated(0), lookups(0), lookupSteps(0), inserts(0),
+	             overwrites(0), insertSteps(0), shifted(0), copied(0) {}
+};
+
+/**
+	Politica di strumentazione di default: tutte le funzioni sono vuote e
+	la classe non ha dati, quindi SparseMatrix (che ne eredita) non ha
+	costi ne' in tempo ne' in memoria.
+	Una politica personalizzata deve fornire le stesse funzioni; stats()
+	e resetStats() servono solo se si usano getStats() e resetStats().
+
+	@brief nessuna strumentazione
+*/
+struct no_instrumentation {
+	/// allocazione di un array di n elementi
+	void onAllocate(const std::size_t) const {}
+	/// lettura che ha richiesto steps passi di ricerca
+	void onLookup(const std::size_t) const {}
+	/// inserimento di un nuovo elemento: passi di ricerca ed elementi spostati
+	void onInsert(const std::size_t, const std::size_t) const {}
+	/// sovrascrittura di un elemento dopo steps passi di ricerca
+	void onOverwrite(const std::size_t) const {}
+	/// copia di n elementi
+	void onCopy(const std::size_t) const {}
+
+	/**
+		@brief statistiche, sempre nulle
+		@return statistiche vuote
+	*/
+	sm_stats stats() const {
+		return sm_stats();
+	}
+
+	/**
+		@brief azzera le statistiche, non fa nulla
+	*/
+	void resetStats() {}
+};
+
+/**
+	Politica di strumentazione che conta allocazioni, passi di ricerca,
+	inserimenti, sovrascritture e copie. I contatori sono atomici (con
+	ordinamento relaxed), quindi le letture concorrenti con operator()
+	sono sicure. Le statistiche appartengono al singolo oggetto: copie e
+	spostamenti della matrice partono da zero.
+
+	@brief strumentazione con contatori
+*/
+class counting_instrumentation {
+public:
+	counting_instrumentation() {
+		resetStats();
+	}
+
+	/**
+		@brief le statistiche non vengono copiate
+	*/
+	counting_instrumentation(const counting_instrumentation &) {
+		resetStats();
+	}
+
+	/**
+		@brief le statistiche non vengono copiate
+		@return reference a this
+	*/
+	counting_instrumentation& operator=(const counting_instrumentation &) {
+		return *this;
+	}
+
+	/// allocazione di un array di n elementi
+	void onAllocate(const std::size_t n) const {
+		add(_allocations, 1);
+		add(_allocated, n);
+	}
+
+	/// lettura che ha richiesto steps passi di ricerca
+	void onLookup(const std::size_t steps) const {
+		add(_lookups, 1);
+		add(_lookupSteps, steps);
+	}
+
+	/// inserimento di un nuovo elemento: passi di ricerca ed elementi spostati
+	void onInsert(const std::size_t steps, const std::size_t shifted) const {
+		add(_inserts, 1);
+		add(_insertSteps, steps);
+		add(_shifted, shifted);
+	}
+
+	/// sovrascrittura di un elemento dopo steps passi di ricerca
+	void onOverwrite(const std::size_t steps) const {
+		add(_overwrites, 1);
+		add(_insertSteps, steps);
+	}
+
+	/// copia di n elementi
+	void onCopy(const std::size_t n) const {
+		add(_copied, n);
+	}
+
+	/**
+		@brief statistiche raccolte
+		@return copia dei contatori
+	*/
+	sm_stats stats() const {
+		sm_stats s;
+		s.allocations = _allocations.load(std::memory_order_relaxed);
+		s.allocated = _allocated.load(std::memory_order_relaxed);
+		s.lookups = _lookups.load(std::memory_order_relaxed);
+		s.lookupSteps = _lookupSteps.load(std::memory_order_relaxed);
+		s.inserts = _inserts.load(std::memory_order_relaxed);
+		s.overwrites = _overwrites.load(std::memory_order_relaxed);
+		s.insertSteps = _insertSteps.load(std::memory_order_relaxed);
+		s.shifted = _shifted.load(std::memory_order_relaxed);
+		s.copied = _copied.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	/**
+		@brief azzera le statistiche
+	*/
+	void resetStats() {
+		_allocations = 0;
+		_allocated = 0;
+		_lookups = 0;
+		_lookupSteps = 0;
+		_inserts = 0;
+		_overwrites = 0;
+		_insertSteps = 0;
+		_shifted = 0;
+		_copied = 0;
+	}
+
+private:
+	typedef std::atomic<unsigned long long> counter;
+
+	mutable counter _allocations, _allocated, _lookups, _lookupSteps, _inserts,
+	                _overwrites, _insertSteps, _shifted, _copied; ///< contatori, vedi sm_stats
+
+	static void add(counter &c, const std::size_t n) {
+		c.fetch_add(n, std::memory_order_relaxed);
+	}
+};
+
+/**
+	Esegue f(t) per t = 0, ..., n-1 su n thread (f(0) sul thread chiamante)
+	e attende che abbiano terminato tutti.
+
+	@brief esecuzione parallela
+
+	@param n numero di thread, almeno 1
+	@param f funzione da eseguire, riceve l'indice del thread
+
+	@throw std::system_error se non e' possibile creare un thread
+*/
+template <typename F>
+void run_parallel(const unsigned int n, F f){
+	std::vector<std::thread> threads;
+	threads.reserve(n);
+
+	try{
+		for(unsigned int t = 1; t < n; ++t)
+			threads.push_back(std::thread(f, t));
+	}
+	catch(...){
+		for(size_t k = 0; k < threads.size(); ++k)
+			threads[k].join();
+		throw;
+	}
+
+	f(0);
+	for(size_t k = 0; k < threads.size(); ++k)
+		threads[k].join();
+}
+
+/**
+	Tratto che riconosce le espressioni su matrici sparse (vedi
+	sm_binary_expr): le specializzazioni definiscono type, il nodo
+	dell'espressione, e wrap, che converte l'operando nel nodo. Per i tipi
+	che non sono espressioni e' vuoto, cosi' gli operatori vengono scartati.
+
+	@brief tratto delle espressioni su matrici sparse
+*/
+template <typename E>
+struct sm_expression_traits {};
+
 /**
 	Classe che implementa una matrice sparsa di dati generici T. 
 	Vengono fisicamente memorizzati soltanto gli elementi esplicitamente
     inseriti nella matrice dall'utente. 
     Gli elementi non inseriti hanno valore di default di tipo T.
 
+	La memoria degli elementi viene richiesta all'allocatore A, riassociato
+	(rebind) al tipo degli elementi.
+	Le coordinate sono di tipo I: un tipo piu' piccolo (ad esempio uint16_t)
+	riduce la memoria di ogni elemento, uno piu' grande (uint64_t) permette
+	matrici con piu' di 2^32 righe o colonne.
+
 	@brief Matrice sparsa
 
 	@param T tipo del dato
+	@param A allocatore, di default std::allocator
+	@param I tipo intero senza segno delle coordinate, di default unsigned int
+	@param S politica di strumentazione, di default no_instrumentation
+	         (nessun costo), counting_instrumentation raccoglie le statistiche
 */
-template <typename T>
-class SparseMatrix{
+template <typename T, typename A = std::allocator<T>, typename I = unsigned int, typename S = no_instrumentation>
+class SparseMatrix : private S {
 
 public: 
-    ///< Definzione del tipo corrispondente a size, nRows, nCols
-    typedef unsigned int sm_size;
+    ///< Definzione del tipo corrispondente a nRows, nCols e alle coordinate
+    typedef I sm_size;
+    typedef std::size_t size_type; ///< Definizione del tipo del numero di elementi inseriti
 	typedef T value_type; ///< Definzione del tipo contenuto nella matrice sparsa
+	typedef A allocator_type; ///< Definizione del tipo dell'allocatore
 
     /**
 		Struttura che implementa un elemento della matrice sparsa
@@ -65,859 +449,3515 @@ public:
             @param jj indice della colonna dell'elemento
             @param v valore dell'elemento
 		*/
-        element(const sm_size ii,const sm_size jj, const value_type &v) : i(ii), j(jj), value(v) {
-            #ifndef NDEBUG
-                std::cout << "element::element(sm_size ii, sm_size jj, const value_type &v)" << std::endl;
-            #endif
-        }
+        element(const sm_size ii,const sm_size jj, const value_type &v) : i(ii), j(jj), value(v) {}
 
         // NOTA: per tutti gli altri metodi fondamentali (operator=, distruttore, copy constructor) vanno 
 		//       bene quelli di default di default
     }; 
 
-private:
-	/**
-		Struttura di supporto interna che implementa un nodo della lista.
-		Utilizzata per memorizzare i valori inseriti dall'utente nella matrice.
-		
-		@brief Nodo della lista
-	*/
-    struct node {
-		element field; ///< elemento inserito nella lista
-        
-		node *next; ///< puntatore al nodo successivo della lista
-
-        /**
-		    @brief Costruttore di default 
-            Costruttore di default
-		*/
-		node() : next(nullptr) {}
-        
-        /**
-			@brief Costruttore secondario
-
-		    Costruttore secondario che inizializza il nodo
-			@param e1 valore dell'elemento.
-		*/
-        node(const element &e1) : field(e1), next(nullptr) {}
-
-        /**
-			@brief Costruttore secondario
+    /**
+		Politica di risoluzione delle coordinate duplicate negli inserimenti
+		di massa.
 
-		    Costruttore secondario che inizializza il nodo
-			@param e1 valore dell'elemento.
-			@param n puntatore al nodo successivo
-		*/
-		node(const element &e1,const node *n) : field(e1), next(n) {}
+		@brief politica per i duplicati
+	*/
+    enum duplicate_policy {
+        last_wins, ///< resta l'ultimo valore inserito
+        sum ///< i valori duplicati vengono sommati
+    };
 
-        // NOTA: per tutti gli altri metodi fondamentali vanno bene quelli di default
-		//       di default
-	}; 
+private:
+    // allocatore riassociato agli elementi e agli indici delle righe
+    typedef typename std::allocator_traits<A>::template rebind_alloc<element> element_allocator;
+    typedef std::allocator_traits<element_allocator> element_traits;
+    typedef std::vector<size_type, typename std::allocator_traits<A>::template rebind_alloc<size_type> > index_vector;
 
+    // true se spostare o scambiare il valore di default non puo' generare eccezioni
+    static const bool nothrow_move = std::is_nothrow_move_constructible<value_type>::value &&
+                                     std::is_nothrow_move_assignable<value_type>::value;
 
     //Attributi della classe 
-    node *_head;  ///< puntatore al primo nodo della lista
+    element_allocator _alloc;  ///< allocatore degli elementi
+    element *_data;  ///< array contiguo degli elementi, ordinato per coordinate (i,j) crescenti
     value_type _D;  ///< valore di default per gli elmenti non inseriti nella matrice sparsa
-    sm_size _size;  ///< numero di elementi della lista
+    size_type _size;  ///< numero di elementi inseriti nell'array
+    size_type _capacity;  ///< numero di elementi allocati nell'array
     sm_size _nRows;  ///< numero di righe della matrice sparsa
     sm_size _nCols;  ///< numero di colonne della matrice sparsa
+    index_vector _rowIndex;  ///< indice opzionale: posizione del primo elemento di ogni riga (vuoto se disattivato)
 
 
     /**
-		Funzione helper per la rimozioni di tutti i nodi nella lista
+		Funzione helper che confronta le coordinate di un elemento con (ii,jj)
+		secondo l'ordine per righe usato nell'array.
 
-		@brief eliminazione di tutti i nodi
-	*/
-    void clear(){
-        node *currNode = _head;
-		node *nextNode = nullptr;
-
-        // scorro tutta la lista fino alla fine
-		while(currNode != nullptr) {
-			nextNode = currNode -> next; // salvo il puntatore al prossimo nodo altrimenti andrebbe perso
-			delete currNode; // elimino il nodo corrente
-			currNode = nextNode; // proseguo dal nodo successivo
-		}
+		@brief confronto tra coordinate
 
-        // azzero tutti i valori, cosi sono in una condizione coerente a fine clear
-		_head = nullptr;
-		_size =0;
-        _nCols = 0;
-        _nRows = 0;
+		@param e elemento da confrontare
+		@param ii indice di riga
+		@param jj indice di colonna
+
+		@return true se e precede (ii,jj)
+	*/
+    static bool less(const element &e, const sm_size ii, const sm_size jj){
+        return e.i < ii || (e.i == ii && e.j < jj);
     }
 
     /**
-		Funzione helper privata per aggiungere un elemento nella matrice sparsa.
-		L'elemento viene inserito rispettando le coordinate (i,j) in ordine
-		crescente. Se la cella è già inizializzata sostituisce soltanto il valore
+		Funzione helper che cerca tramite ricerca binaria la posizione del primo
+		elemento con coordinate maggiori o uguali a (ii,jj).
+		Se l'indice delle righe e' attivo la ricerca e' limitata alla riga ii.
 
-		@brief Inserisce un elemento nella matrice
+		@brief ricerca binaria della posizione di (ii,jj)
 
-		@param e elemento da inserire
+		@param ii indice di riga
+		@param jj indice di colonna
+		@param steps incrementato di uno per ogni passo della ricerca
 
-		@throw index_out_of_bounds_exception
-		@throw eccezione di allocazione di memoria (runtime) 
+		@return posizione del primo elemento non minore di (ii,jj), _size se non esiste
 	*/
-    void add(const element &e){
-        // controllo che mi abbia passato indici validi, altrimenti genero un'eccezione
-        if (e.i < _nRows && e.j < _nCols && e.i >= 0 && e.j >= 0){
-			
-			node *tmp;
-
-            // se la lista è vuota aggiungo l'elemento all'inizio della lista
-            if(_head == nullptr){
-
-				try{
-					// creo il nuovo nodo da aggiungere
-					tmp = new node(e);
-				}
-				catch(...){
-					tmp = nullptr; // per essere piu sicuro
-					throw;
-				}
-                _head = tmp;
-                ++_size;
-                return;
-            }
+    size_type lower_bound(const sm_size ii, const sm_size jj, size_type &steps) const {
+        size_type first = 0;
+        size_type count = _size;
 
+        if(!_rowIndex.empty()){
+            first = _rowIndex[ii];
+            count = _rowIndex[ii + 1] - first;
+        }
 
-            // se la lista non è vuota, ciclo sui nodi finchè non trovo la posizione dove voglio inserire
+        while(count > 0){
+            size_type step = count / 2;
+            ++steps;
+            if(less(_data[first + step], ii, jj)){
+                first += step + 1;
+                count -= step + 1;
+            }
+            else
+                count = step;
+        }
 
-            node *currNode = _head; // nodo per ciclare
-            // tengo in memoria qual è il nodo prima di currNode, cosi possso fare l'inserimento
-            node *prevNode = _head; 
+        return first;
+    }
 
-            while(currNode != nullptr){ // finche non sono arrivato all'ultimo nodo
-                // se l'indice di riga o di colonna è maggiore del nodo che sto analizzando vado avanti
-                if(currNode -> field.i < e.i || currNode -> field.j < e.j) {
-                    prevNode = currNode;
-                    currNode = currNode -> next;
-                }
-                else{	// inserisco il nuovo elemento
-                    // sto inserendo un elemento in una posizione che esiste già, lo sovrascrivo
-                    if (currNode -> field.i == e.i && currNode -> field.j == e.j) {
-                        currNode -> field.value = e.value;
-                        //delete tmp; // lo cancello perchè ho solo modificato il valore quindi disalloco lo spazio
-                        return; // non aumento size perchè non ho realmente aggiunto un elemento
-                    }
+    /**
+		@brief ricerca binaria della posizione di (ii,jj), senza contare i passi
+	*/
+    size_type lower_bound(const sm_size ii, const sm_size jj) const {
+        size_type steps = 0;
+        return lower_bound(ii, jj, steps);
+    }
 
-					try{
-						// creo il nuovo nodo da aggiungere
-						tmp = new node(e);
-					}
-					catch(...){
-						tmp = nullptr; // per essere piu sicuro
-						throw;
-					}
-
-                    // se devo inserirlo davanti devo sistemare l'head!
-                    if (_head == currNode){
-                        _head = tmp;
-                    }
-                    else{
-                        prevNode -> next = tmp; 
-                    }
+    /**
+		Funzione helper che alloca un array per n elementi tramite l'allocatore
 
-                    tmp -> next = currNode;
-                    ++_size;
-                    return;
-                    
-                }
-            }
+		@brief alloca l'array degli elementi
 
-			try{
-				// creo il nuovo nodo da aggiungere
-				tmp = new node(e);
-			}
-			catch(...){
-				tmp = nullptr; // per essere piu sicuro
-				throw;
-			}
+		@param n numero di elementi
+		@return array allocato, nullptr se n e' 0
 
-            // caso in cui voglio aggiungere un valore più grande di tutti
-            prevNode -> next = tmp; 
-            ++_size; 
-        }
-        else
-            throw index_out_of_bounds_exception();
-	}
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    element *allocate(const size_type n){
+        if(n == 0)
+            return nullptr;
 
+        element *p = element_traits::allocate(_alloc, n);
+        S::onAllocate(n);
+        return p;
+    }
 
-public:
     /**
-        @brief Costruttore secondario
-
-        Costruttore secondario. Permette di istanziare una matrice sparsa con una 
-        data dimensione e un valore di default.
+		@brief costruisce una copia di e nella posizione p tramite l'allocatore
+	*/
+    void construct(element *p, const element &e){
+        element_traits::construct(_alloc, p, e);
+    }
 
-        @param r numero di righe della matrice
-        @param c numero di colonne della matrice
-        @param dv valore di default degli elementi della matrice
-    */
-	SparseMatrix(const sm_size r,const sm_size c, const value_type &dv) 
-        : _size(0), _head(nullptr), _nCols(c), _nRows(r), _D(dv) {
+    /**
+		Funzione helper che distrugge gli elementi e restituisce l'array
+		all'allocatore
 
-        
-        #ifndef NDEBUG
-            std::cout << "SparseMatrix::SparseMatrix(sm_size r, sm_size c, const value_type &dv)" << std::endl;
-        #endif
+		@brief libera l'array degli elementi
 
-    };
+		@param data array da liberare
+		@param n numero di elementi costruiti nell'array
+		@param cap capacita' dell'array
+	*/
+    void destroy(element *data, const size_type n, const size_type cap){
+        for(size_type k = 0; k < n; ++k)
+            element_traits::destroy(_alloc, data + k);
+        if(data != nullptr)
+            element_traits::deallocate(_alloc, data, cap);
+    }
 
+    /**
+		@brief scambia gli allocatori se l'allocatore lo prevede
+	*/
+    static void swap_allocator(element_allocator &a, element_allocator &b, std::true_type){
+        using std::swap;
+        swap(a, b);
+    }
 
-	/**
-		@brief Distruttore (METODO FONDAMENTALE)
+    /**
+		@brief gli allocatori non vanno scambiati
+	*/
+    static void swap_allocator(element_allocator &, element_allocator &, std::false_type){}
 
-		Distruttore. Rimuove la memoria allocata dalla matrice sparsa.
-	**/
-	~SparseMatrix(){
-        clear();
-        #ifndef NDEBUG
-            std::cout << "SparseMatrix::~SparseMatrix()" << std::endl;
-        #endif
-    }
+    /**
+		Funzione helper che alloca un nuovo array di capacita' newCap e vi copia
+		gli elementi correnti. Se gap < _size lascia libera la posizione gap
+		(gli elementi da gap in poi vengono spostati di una posizione) e vi
+		costruisce l'elemento e.
 
-	/**
-		@brief Operatore di assegnamento (METODO FONDAMENTALE)
+		@brief riallocazione dell'array
 
-        Operatore di assegnamento. Permette la copia tra dbuffer.
-		
-		@param other matrice sparsa da copiare
-		@return reference a this
+		@param newCap nuova capacita' dell'array
+		@param gap posizione in cui inserire e
+		@param e elemento da inserire in posizione gap (ignorato se gap > _size)
 
-		@throw index_out_of_bounds_exception
 		@throw eccezione di allocazione di memoria (runtime)
 	*/
-	SparseMatrix& operator=(const SparseMatrix &other){
-		if(this != &other){
-			SparseMatrix tmp(other); // copio l'altra matrice
-            // swappo tutti i valori
-            std::swap(this -> _nCols, tmp._nCols);
-			std::swap(this -> _nRows, tmp._nRows);
-            std::swap(this -> _D, tmp._D);
-			std::swap(this -> _head, tmp._head);
-			std::swap(this -> _size, tmp._size);
-		}
-
-        #ifndef NDEBUG
-            std::cout << "SparseMatrix::operator=(const SparseMatrix &other)" << std::endl;
-        #endif
-
-		return *this;
-	}
+    void reallocate(const size_type newCap, const size_type gap, const element *e){
+        element *tmp = allocate(newCap);
+        size_type built = 0;
+
+        try{
+            for(size_type k = 0; k < _size; ++k){
+                if(k == gap){
+                    construct(tmp + built, *e);
+                    ++built;
+                }
+                construct(tmp + built, _data[k]);
+                ++built;
+            }
+            if(gap == _size){
+                construct(tmp + built, *e);
+                ++built;
+            }
+        }
+        catch(...){
+            destroy(tmp, built, newCap); // la matrice rimane invariata
+            throw;
+        }
 
+        S::onCopy(_size);
+        destroy(_data, _size, _capacity);
+        _data = tmp;
+        _capacity = newCap;
+        _size = built;
+    }
 
-	/**
-        @brief Copy constructor (METODO FONDAMENTALE)
+    /**
+		Funzione helper che inserisce l'elemento e in posizione pos dell'array,
+		spostando in avanti gli elementi successivi.
 
-		Costruttore di copia. Permette di istanziare una matrice sparsa 
-        con i valori presi da un altra matrice spara.
+		@brief inserimento in posizione pos
 
-		@param other matrice sparsa da copiare
+		@param pos posizione di inserimento
+		@param e elemento da inserire
 
-		@throw index_out_of_bounds_exception
 		@throw eccezione di allocazione di memoria (runtime)
 	*/
-    SparseMatrix(const SparseMatrix &other) : _size(0), _head(nullptr), _nCols(0), _nRows(0){
-        //TODO devo gestire la new che c'è nella add, potrebbe fallire
+    void insert(const size_type pos, const element &e){
+        // se la copia puo' fallire rialloco, cosi' in caso di eccezione la matrice rimane invariata
+        if(_size == _capacity || (pos < _size && !noexcept(element(e)))){
+            reallocate(_size == _capacity ? (_capacity == 0 ? 4 : _capacity * 2) : _capacity, pos, &e);
+        }
+        else{
+            if(pos < _size){
+                // le coordinate sono const, quindi sposto gli elementi distruggendo e ricostruendo
+                construct(_data + _size, _data[_size - 1]);
+                for(size_type k = _size - 1; k > pos; --k){
+                    element_traits::destroy(_alloc, _data + k);
+                    construct(_data + k, _data[k - 1]);
+                }
+                element_traits::destroy(_alloc, _data + pos);
+            }
+            construct(_data + pos, e);
+            ++_size;
+        }
 
-            node *currNode = other._head; // salvo il puntatore alla testa
-            // usando la add devo aver già definito tutti i valori
-            _nCols = other._nCols;
-            _nRows = other._nRows;
-            _D = other._D;
-            
-			try {
-				while(currNode != nullptr) {
-					add(currNode -> field); // sistema già anche la size
-					currNode = currNode -> next; // mi sposto al nodo successivo
-				}	
-			}
-			//NOTA: sto catchando anche index_out_of_bounds ma questa eccezione non avverrà mai perchè sto copiando
-			// un altra matrice valida.
-			catch(...) { 
-				clear(); // se qualche add non va a buon fine svuoto tutta la matrice
-				throw;
-			}
-            
-        #ifndef NDEBUG
-            std::cout << "SparseMatrix::SparseMatrix(const SparseMatrix &other)" << std::endl;
-        #endif
+        // le righe successive iniziano una posizione piu' avanti
+        if(!_rowIndex.empty())
+            for(size_type r = static_cast<size_type>(e.i) + 1; r <= _nRows; ++r)
+                ++_rowIndex[r];
     }
-    
-        
+
     /**
-		@brief Costruttore secondario
+		Funzione helper che rimuove gli elementi per cui pred e' vero,
+		valutandolo una sola volta per elemento e nell'ordine dell'array.
+		Se la copia di un elemento non puo' fallire compatta l'array sul
+		posto; altrimenti copia gli elementi rimasti in un nuovo array della
+		stessa capacita', cosi' in caso di eccezione la matrice rimane
+		invariata. L'indice delle righe viene ricostruito se attivo.
 
-		Costruttore secondario che costruisce la matrice sparsa a partire
-		da un'altra matrice sparsa di tipo generico Q.
+		@brief rimozione degli elementi che soddisfano pred
 
-		@param other matrice sparsa da copiare
+		@return numero di elementi rimossi
 
-		@throw index_out_of_bounds_exception
 		@throw eccezione di allocazione di memoria (runtime)
 	*/
-	template <typename Q>
-	SparseMatrix(const SparseMatrix<Q> &other) : _size(0), _head(nullptr), _nCols(0), _nRows(0) {
-        // sfrutto gli operatori
-        typename SparseMatrix<Q> :: const_iterator ib, ie;
-
-        ib = other.begin();
-        ie = other.end();
+    template <typename P>
+    size_type remove_where(P pred){
+        size_type r = 0;
+        while(r < _size && !pred(_data[r]))
+            ++r;
+        if(r == _size)
+            return 0;
+
+        if(!noexcept(element(std::declval<const element&>()))){
+            element *tmp = allocate(_capacity);
+            size_type built = 0;
+
+            try{
+                for(; built < r; ++built)
+                    construct(tmp + built, _data[built]);
+                for(++r; r < _size; ++r)
+                    if(!pred(_data[r])){
+                        construct(tmp + built, _data[r]);
+                        ++built;
+                    }
+            }
+            catch(...){
+                destroy(tmp, built, _capacity); // la matrice rimane invariata
+                throw;
+            }
 
-        _nCols = other.getNumCols();
-        _nRows = other.getNumRows();
-		_D = static_cast<value_type>(other.getDefaultValue()); // casto il valore di default 
+            const size_type removed = _size - built;
+            S::onCopy(built);
+            destroy(_data, _size, _capacity);
+            _data = tmp;
+            _size = built;
+            if(!_rowIndex.empty())
+                setRowIndex(true);
+            return removed;
+        }
 
-		try{
-			while(ib != ie){
-				element tmpE(ib -> i, ib -> j, static_cast<value_type>(ib -> value));
-				add(tmpE);
-				++ib;
-			}
+        // le coordinate sono const, quindi sposto gli elementi distruggendo e ricostruendo
+        size_type w = r;
+        try{
+            for(++r; r < _size; ++r){
+                if(pred(_data[r]))
+                    continue;
+                element_traits::destroy(_alloc, _data + w);
+                construct(_data + w, _data[r]);
+                ++w;
+            }
+        }
+        catch(...){
+            // pred ha lanciato: tengo tutti gli elementi non ancora esaminati
+            for(; r < _size; ++r, ++w){
+                element_traits::destroy(_alloc, _data + w);
+                construct(_data + w, _data[r]);
+            }
+            truncate(w);
+            throw;
         }
-		//NOTA: sto catchando anche index_out_of_bounds ma questa eccezione non avverrà mai perchè sto copiando
-		// un altra matrice valida.
-		catch(...) { 
-			clear(); // se qualche add non va a buon fine svuoto tutta la matrice
-			throw;
-		}
 
-        #ifndef NDEBUG
-            std::cout << "SparseMatrix(const SparseMatrix<Q> &other)" << std::endl;
-        #endif	    
-	}
+        return truncate(w);
+    }
 
     /**
-		@brief Inserimento di un elemento nella matrice
+		Funzione helper che rimuove l'elemento in posizione pos, spostando
+		indietro di una posizione soltanto gli elementi successivi. Se la
+		copia di un elemento puo' fallire gli elementi rimasti vengono copiati
+		in un nuovo array della stessa capacita', come in insert, cosi' in
+		caso di eccezione la matrice rimane invariata.
 
-        Inserisce un elemento nella matrice in posizione (i,j) con valore value
-		L'elemento viene inserito rispettando le coordinate (i,j) in ordine
-		crescente. Se la cella è già inizializzata sostituisce soltanto il valore
+		@brief rimozione dell'elemento in posizione pos
 
-		@param value valore da inserire
-		@param ii indice della riga in cui inserire l'elemento        
-		@param jj indice della colonna in cui inserire l'elemento  
+		@param pos posizione dell'elemento da rimuovere, minore di _size
 
-		@throw index_out_of_bounds_exception
-		@throw eccezione di allocazione di memoria (runtime)
+		@throw eccezione di allocazione di memoria (runtime), solo se la copia di T puo' fallire
 	*/
-    void add(const sm_size ii, const sm_size jj, const value_type& value){
-        element tmpE(ii,jj,value);
-        add(tmpE); // richiamo il metodo privato di add 
-	}
-	
+    void remove_at(const size_type pos){
+        const sm_size row = _data[pos].i;
+
+        if(!noexcept(element(std::declval<const element&>()))){
+            element *tmp = allocate(_capacity);
+            size_type built = 0;
+
+            try{
+                for(; built < pos; ++built)
+                    construct(tmp + built, _data[built]);
+                for(; built + 1 < _size; ++built)
+                    construct(tmp + built, _data[built + 1]);
+            }
+            catch(...){
+                destroy(tmp, built, _capacity); // la matrice rimane invariata
+                throw;
+            }
+
+            S::onCopy(built);
+            destroy(_data, _size, _capacity);
+            _data = tmp;
+        }
+        else{
+            // le coordinate sono const, quindi sposto gli elementi distruggendo e ricostruendo
+            for(size_type k = pos + 1; k < _size; ++k){
+                element_traits::destroy(_alloc, _data + k - 1);
+                construct(_data + k - 1, _data[k]);
+            }
+            element_traits::destroy(_alloc, _data + _size - 1);
+        }
+        --_size;
+
+        // le righe successive iniziano una posizione piu' indietro
+        if(!_rowIndex.empty())
+            for(size_type r = static_cast<size_type>(row) + 1; r <= _nRows; ++r)
+                --_rowIndex[r];
+    }
+
     /**
-		@brief Accesso ai dati in lettura
+		@brief distrugge gli elementi dalla posizione n in poi
 
-        Metodo per leggere il valore dell'elemento in posizione (i,j) della
-        matrice. Se l'elemento non è inserito ritorna il valore di default.
+		@return numero di elementi distrutti
+	*/
+    size_type truncate(const size_type n){
+        const size_type removed = _size - n;
+        for(size_type k = n; k < _size; ++k)
+            element_traits::destroy(_alloc, _data + k);
+        _size = n;
+        if(!_rowIndex.empty())
+            setRowIndex(true);
+        return removed;
+    }
 
-		@param ii indice della riga    
-		@param jj indice della colonna
+    /**
+		Terna di supporto usata negli inserimenti di massa. A differenza di
+		element e' assegnabile, quindi puo' essere ordinata. Le coordinate sono
+		a 64 bit, cosi' vengono controllate prima di convertirle in sm_size.
 
-        @return valore dell'elemento in posizione (ii,jj)
-		
-		@throw index_out_of_bounds_exception
+		@brief terna (i,j,valore)
 	*/
-    const value_type& operator()(const sm_size ii,const sm_size jj) const {
-       
-		#ifndef NDEBUG
-            std::cout << "SparseMatrix::operator()(sm_size ii, sm_size jj)" << std::endl;
-        #endif	
-        
-        if (ii < _nRows && jj < _nCols && ii >= 0 && jj >= 0){
+    struct triplet {
+        unsigned long long i, j; ///< coordinate
+        value_type value; ///< valore
 
-            node *currNode = _head;
-            while(currNode != nullptr){
-                if(currNode -> field.i < ii || currNode -> field.j < jj) {
-                    currNode = currNode -> next;
-                }
-                else if (currNode -> field.i == ii && currNode -> field.j == jj){
-                    
-                    return currNode -> field.value;
-                }
-                else
-                    return _D;
-                
-            }
+        triplet(const unsigned long long ii, const unsigned long long jj, const value_type &v) : i(ii), j(jj), value(v) {}
 
-            
-            return _D; // non è salvato quindi ritorno il valore di default
+        bool operator<(const triplet &other) const {
+            return i < other.i || (i == other.i && j < other.j);
         }
-        else
-            throw index_out_of_bounds_exception();
-        
-	}
-    
-   
-    /**
-		@brief numero di righe della matrice
-
-		Ritorna il numero di righe della matrice
+    };
 
-		@return numero di righe della matrice
+    /**
+		@brief conversione in terna di un elemento (qualunque struttura con campi i, j, value)
 	*/
-    sm_size getNumRows() const{
-        return _nRows;
+    template <typename E>
+    static triplet to_triplet(const E &e){
+        return triplet(e.i, e.j, static_cast<value_type>(e.value));
     }
 
     /**
-		@brief numero di colonne della matrice
+		@brief conversione in terna di una std::tuple (i, j, valore)
+	*/
+    template <typename R, typename C, typename V>
+    static triplet to_triplet(const std::tuple<R, C, V> &t){
+        return triplet(std::get<0>(t), std::get<1>(t), static_cast<value_type>(std::get<2>(t)));
+    }
 
-		Ritorna il numero di colonne della matrice
+    /**
+		@brief funtore che tiene l'ultimo valore tra due duplicati
+	*/
+    struct keep_last {
+        const value_type& operator()(const value_type &, const value_type &b) const {
+            return b;
+        }
+    };
 
-		@return numero di colonne della matrice
+    /**
+		@brief funtore che somma due valori duplicati
 	*/
-    sm_size getNumCols() const{
-        return _nCols;
-    }
+    struct add_values {
+        value_type operator()(const value_type &a, const value_type &b) const {
+            return a + b;
+        }
+    };
 
-    
-	/**
-		@brief numero di elementi inseriti nella matrice
+    /**
+		Funzione helper che sostituisce il contenuto della matrice con le terne
+		date, gia' ordinate e senza duplicati. Alloca l'array una sola volta
+		e ricostruisce l'indice delle righe se attivo.
 
-		Ritorna il numero di elementi inseriti nella matrice sparsa
+		@brief sostituzione del contenuto con terne ordinate
 
-		@return numero di elementi inseriti
+		@param t inizio delle terne (triplet, element o std::tuple), ordinate
+		         per (i,j), senza duplicati e con indici gia' controllati
+		@param n numero di terne da usare
+
+		@throw eccezione di allocazione di memoria (runtime)
 	*/
-    sm_size getNumElement() const{
-        return _size;
+    template <typename ForwardIt>
+    void replace(ForwardIt t, const size_type n){
+        element *tmp = allocate(n);
+        size_type built = 0;
+
+        try{
+            for(; built < n; ++built, ++t){
+                const triplet tr = to_triplet(*t);
+                element_traits::construct(_alloc, tmp + built, static_cast<sm_size>(tr.i),
+                                          static_cast<sm_size>(tr.j), tr.value);
+            }
+        }
+        catch(...){
+            destroy(tmp, built, n); // la matrice rimane invariata
+            throw;
+        }
+
+        destroy(_data, _size, _capacity);
+        _data = tmp;
+        _size = n;
+        _capacity = n;
+
+        if(!_rowIndex.empty())
+            setRowIndex(true);
     }
 
-	/**
-		@brief valore di default della matrice
+    /**
+		Funzione helper che riempie la matrice, appena costruita e vuota, con
+		il risultato dell'espressione. Le k matrici dell'espressione vengono
+		fuse avanzando k cursori: a ogni passo si prendono le coordinate
+		minime, si segnalano all'espressione le matrici che hanno un elemento
+		in quella posizione e si accoda il valore calcolato. k e' una costante
+		di compilazione, quindi i cicli sui cursori sono brevi e srotolabili.
 
-		Ritorna il valore di default della matrice
+		@brief fusione a k vie di un'espressione
 
-		@return valore di default
+		@throw eccezione di allocazione di memoria (runtime)
 	*/
-    const value_type& getDefaultValue() const{
-        return _D;
-    }
+    template <typename E>
+    void fuse(const E &expr, const bool dropDefault){
+        const unsigned int k = E::leaves;
+        const SparseMatrix *m[E::leaves];
+        const element *p[E::leaves], *last[E::leaves], *cur[E::leaves];
+
+        expr.collect(m);
+        size_type total = 0;
+        for(unsigned int l = 0; l < k; ++l){
+            p[l] = m[l] -> _data;
+            last[l] = m[l] -> _data + m[l] -> _size;
+            total += m[l] -> _size;
+        }
 
+        _data = allocate(total);
+        _capacity = total;
 
+        while(true){
+            const element *min = nullptr;
+            for(unsigned int l = 0; l < k; ++l)
+                if(p[l] != last[l] && (min == nullptr || less(*p[l], min -> i, min -> j)))
+                    min = p[l];
+            if(min == nullptr)
+                break;
 
-    // ------------- ITERATOR ----------------
-    class const_iterator; // forward declaration
+            const sm_size ii = min -> i, jj = min -> j;
+            for(unsigned int l = 0; l < k; ++l)
+                cur[l] = (p[l] != last[l] && p[l] -> i == ii && p[l] -> j == jj) ? p[l]++ : nullptr;
+
+            const value_type v = expr.at(cur);
+            if(dropDefault && v == _D)
+                continue;
+
+            element_traits::construct(_alloc, _data + _size, ii, jj, v);
+            ++_size;
+        }
+    }
 
     /**
-		Iteratore della matrice
+		Funzione helper che converte in terne gli elementi di [first, last),
+		controllandone gli indici, le ordina e unisce i duplicati con reduce.
+		Le terne valide sono le prime n del vettore.
 
-		@brief Iteratore della matrice
+		@brief terne ordinate e senza duplicati di un intervallo
+
+		@return numero n di terne distinte
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
 	*/
-	class iterator {
-		//	
-	public:
-		typedef std::forward_iterator_tag iterator_category;
-		typedef element value_type;
-		typedef ptrdiff_t difference_type;
-		typedef element* pointer;
-		typedef element& reference;
+    template <typename InputIt, typename Reducer>
+    size_type sorted_triplets(InputIt first, InputIt last, Reducer &reduce, std::vector<triplet> &t) const {
+        for(; first != last; ++first){
+            triplet tr = to_triplet(*first);
+            if(tr.i >= _nRows || tr.j >= _nCols)
+                throw index_out_of_bounds_exception();
+            t.push_back(tr);
+        }
 
-		/**
-			Costruttore dell'iteratore
-			@brief Setta il nodo a nullptr
-		*/
-		iterator() : _nPtr(nullptr) {}
+        // stabile: a parita' di coordinate resta l'ordine di inserimento
+        std::stable_sort(t.begin(), t.end());
+
+        // unisco i duplicati compattando il vettore
+        size_type n = 0;
+        for(size_t k = 0; k < t.size(); ++k){
+            if(n > 0 && t[n - 1].i == t[k].i && t[n - 1].j == t[k].j)
+                t[n - 1].value = reduce(t[n - 1].value, t[k].value);
+            else{
+                if(n != k)
+                    t[n] = t[k];
+                ++n;
+            }
+        }
 
-		/**
-			Copy constructor dell'iteratore
+        return n;
+    }
 
-			@brief copy constructor 
+    /**
+		Funzione helper che fonde le terne date, ordinate e senza duplicati,
+		con gli elementi della matrice. Una prima passata conta gli elementi
+		del risultato, cosi' il nuovo array viene allocato una sola volta e
+		della dimensione esatta; la seconda lo costruisce. Le coordinate
+		presenti in entrambi prendono il valore reduce(vecchio, nuovo).
 
-			@param un altro iteratore costante other
-		*/		
-		iterator(const iterator &other) : _nPtr(other._nPtr) {}
+		@brief fusione di terne ordinate con la matrice
 
-		/**
-			Ridefinizione operator =
+		@param t terne ordinate per (i,j) e senza duplicati
+		@param n numero di terne da usare
+		@param reduce funzione binaria che combina i valori con le stesse coordinate
 
-			@brief operatore di assegnamento
-			@param un altro iteratore costante other
-			@return riferimento all'iteratore
-		*/
-		iterator& operator=(const iterator &other) {
-			_nPtr = other._nPtr;
-            return *this;
-		}
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    template <typename Reducer>
+    void merge(const std::vector<triplet> &t, const size_type n, Reducer &reduce){
+        size_type total = _size + n;
+        for(size_type p = 0, q = 0; p < _size && q < n; ){
+            if(less(_data[p], static_cast<sm_size>(t[q].i), static_cast<sm_size>(t[q].j)))
+                ++p;
+            else if(_data[p].i == t[q].i && _data[p].j == t[q].j){
+                --total;
+                ++p;
+                ++q;
+            }
+            else
+                ++q;
+        }
 
-		/**
-			Distruttore dell'iteratore
+        element *tmp = allocate(total);
+        size_type built = 0;
+
+        try{
+            size_type p = 0, q = 0;
+            for(; built < total; ++built){
+                if(q == n || (p < _size && less(_data[p], static_cast<sm_size>(t[q].i), static_cast<sm_size>(t[q].j))))
+                    construct(tmp + built, _data[p++]);
+                else if(p == _size || _data[p].i != t[q].i || _data[p].j != t[q].j){
+                    element_traits::construct(_alloc, tmp + built, static_cast<sm_size>(t[q].i),
+                                              static_cast<sm_size>(t[q].j), t[q].value);
+                    ++q;
+                }
+                else{
+                    element_traits::construct(_alloc, tmp + built, _data[p].i, _data[p].j,
+                                              reduce(_data[p].value, t[q].value));
+                    ++p;
+                    ++q;
+                }
+            }
+        }
+        catch(...){
+            destroy(tmp, built, total); // la matrice rimane invariata
+            throw;
+        }
 
-			@brief distruttore
-		*/
-		~iterator() {}
+        destroy(_data, _size, _capacity);
+        _data = tmp;
+        _size = total;
+        _capacity = total;
 
-		/** 
-			ritorna il dato riferito dall'iteratore (dereferenziamento)
-			
-			@brief operatore di deferenziamento
+        if(!_rowIndex.empty())
+            setRowIndex(true);
+    }
 
-			@return struct element
-		*/
-		reference operator*() const {
-			return _nPtr -> field;
-		}
+    /**
+		Funzione helper che risolve le richieste coords[q0..q1) di lookup_batch:
+		le ordina per coordinate e le scorre insieme all'array degli elementi.
+		Per ogni richiesta cerca la posizione raddoppiando il passo a partire
+		da quella della richiesta precedente, poi con una ricerca binaria
+		nell'ultimo intervallo.
 
-		/** 
-			ritorna il dato riferito dall'iteratore
+		@brief lettura ordinata di un blocco di richieste
 
-			@brief operatore ->
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    void lookup_block(const std::pair<sm_size, sm_size> *coords, const size_type q0, const size_type q1,
+                      value_type *values) const {
+        // ordino copie contigue delle richieste: l'ordinamento non salta tra coords e gli indici
+        std::vector<std::pair<std::pair<sm_size, sm_size>, size_type> > order(q1 - q0);
+        for(size_type q = q0; q < q1; ++q)
+            order[q - q0] = std::make_pair(coords[q], q);
+        std::sort(order.begin(), order.end());
+
+        size_type cursor = 0;
+        for(size_type n = 0; n < order.size(); ++n){
+            const sm_size ii = order[n].first.first, jj = order[n].first.second;
+            size_type steps = 0;
+
+            // [first, last) contiene il primo elemento non minore di (ii,jj)
+            size_type first = cursor, last = cursor, step = 1;
+            while(last < _size && less(_data[last], ii, jj)){
+                first = last + 1;
+                last += step;
+                step *= 2;
+                ++steps;
+            }
+            if(last > _size)
+                last = _size;
+
+            size_type count = last - first;
+            while(count > 0){
+                const size_type half = count / 2;
+                ++steps;
+                if(less(_data[first + half], ii, jj)){
+                    first += half + 1;
+                    count -= half + 1;
+                }
+                else
+                    count = half;
+            }
 
-			@return puntatore ad un element
-		*/
-		pointer operator->() const {
-			return &(_nPtr -> field);
-		}
+            S::onLookup(steps);
+            cursor = first;
+            values[order[n].second] = (first < _size && _data[first].i == ii && _data[first].j == jj) ? _data[first].value : _D;
+        }
+    }
 
-		/** 
-			Operatore di post-incremento dell'iteratore
+    /**
+		Funzione helper che calcola y[r] = (A x)[r] per le righe [r0, r1), i cui
+		elementi occupano le posizioni [k0, k1) dell'array.
+		base e' il contributo del valore di default, _D * somma(x); gli elementi
+		memorizzati contribuiscono con (valore - _D) * x[j].
+		La somma di ogni riga e' calcolata da row_dot.
 
-			@brief operatore di post-incremento 
+		@brief prodotto matrice-vettore su un intervallo di righe
+	*/
+    void multiply_rows(const value_type *x, value_type *y, const sm_size r0, const sm_size r1,
+                       size_type k, const size_type k1, const value_type &base, const bool zeroDefault) const {
+        for(sm_size r = r0; r < r1; ++r){
+            size_type end = k;
+            while(end < k1 && _data[end].i == r)
+                ++end;
+
+            value_type acc = value_type();
+            if(end > k)
+                acc = row_dot(k, end, x, !zeroDefault, std::is_same<sm_size, unsigned int>());
+
+            y[r] = base + acc;
+            k = end;
+        }
+    }
 
-			@return l'iteratore pre incremento
-		*/
-		iterator operator++(int) {
-			iterator tmp(*this);
-			_nPtr = _nPtr -> next;
-			return tmp;
-		}
+    /**
+		Funzione helper che calcola la somma dei prodotti degli elementi
+		[k, end) con x tramite spmv_kernel, vettorizzato per float e double.
+		I kernel vettorizzati leggono gli indici come interi a 32 bit con segno,
+		quindi sono usati solo se il numero di colonne non supera 2^31 - 1.
 
-		/** 
-			Operatore di pre-incremento dell'iteratore
+		@brief somma dei prodotti di una riga, indici a 32 bit
+	*/
+    value_type row_dot(const size_type k, const size_type end, const value_type *x, const bool useShift, std::true_type) const {
+        if(_nCols <= 0x7fffffffu)
+            return spmv_kernel<value_type>::dot(&_data[k].j, sizeof(element), &_data[k].value, sizeof(element),
+                                                end - k, x, _D, useShift);
 
-			@brief operatore di pre-incremento 
+        return row_dot(k, end, x, useShift, std::false_type());
+    }
 
-			@return l'iteratore incrementato
-		*/
-		iterator& operator++() {
-			_nPtr = _nPtr -> next;
-            return *this;
-		}
+    /**
+		@brief somma dei prodotti di una riga con il ciclo scalare, per ogni tipo di indice
+	*/
+    value_type row_dot(const size_type k, const size_type end, const value_type *x, const bool useShift, std::false_type) const {
+        return spmv_scalar_dot<value_type>(&_data[k].j, sizeof(element), &_data[k].value, sizeof(element),
+                                           end - k, x, _D, useShift);
+    }
 
-		/** 
-		 	Ridefinizione dell'operatore di uguaglianza
+    /**
+		Funzione helper che divide le righe in blocchi contigui con circa lo
+		stesso numero di elementi, uno per thread: il blocco t contiene le
+		righe [rows[t], rows[t+1]) e gli elementi [elems[t], elems[t+1]).
 
-			@brief Operatore di uguaglianza
+		@brief divisione delle righe tra i thread
 
-			@param un altro iteratore costante other
-			@return Risultato dell'uguaglianza
-		*/
-		bool operator==(const iterator &other) const {
-			return _nPtr == other._nPtr;
-		}
+		@param threads numero di thread richiesto, 0 per un thread per core
+		@param rows confini dei blocchi di righe (threads + 1 valori)
+		@param elems confini dei blocchi di elementi (threads + 1 valori)
+		@return numero di blocchi, almeno 1 e al massimo il numero di righe
+	*/
+    unsigned int partitionRows(unsigned int threads, std::vector<sm_size> &rows, std::vector<size_type> &elems) const {
+        if(threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if(threads > _nRows)
+            threads = _nRows;
+        if(threads == 0)
+            threads = 1;
+
+        rows.assign(threads + 1, _nRows);
+        elems.assign(threads + 1, _size);
+        rows[0] = 0;
+        elems[0] = 0;
+        for(unsigned int t = 1; t < threads; ++t){
+            size_type k = static_cast<size_type>(static_cast<unsigned long long>(_size) * t / threads);
+            rows[t] = k < _size ? _data[k].i : _nRows;
+            if(rows[t] < rows[t - 1])
+                rows[t] = rows[t - 1];
+            elems[t] = rows[t] < _nRows ? lower_bound(rows[t], 0) : _size;
+        }
 
-		/** 
-		 	Ridefinizione dell'operatore di diseguaglianza
+        return threads;
+    }
 
-			@brief Operatore di uguaglianza
+    /**
+		Funzione helper che calcola la posizione del primo elemento di ogni
+		riga (come l'indice delle righe, che viene copiato se attivo).
 
-			@param un altro iteratore costante other
-			@return Risultato della diseguaglianza
-		*/
-		bool operator!=(const iterator &other) const {
-			return _nPtr != other._nPtr;
-		}
+		@brief posizioni di inizio delle righe
+
+		@return vettore di getNumRows() + 1 posizioni
+	*/
+    std::vector<size_type> rowStarts() const {
+        if(!_rowIndex.empty())
+            return std::vector<size_type>(_rowIndex.begin(), _rowIndex.end());
+
+        std::vector<size_type> starts(static_cast<size_type>(_nRows) + 1, 0);
+        for(size_type k = 0; k < _size; ++k)
+            ++starts[_data[k].i + 1];
+        for(sm_size r = 0; r < _nRows; ++r)
+            starts[r + 1] += starts[r];
+        return starts;
+    }
+
+    /**
+		Funzione helper che scambia tutti i dati con other, tranne l'allocatore
+
+		@brief scambio del contenuto
+	*/
+    void swap_content(SparseMatrix &other) noexcept(nothrow_move){
+        std::swap(_nCols, other._nCols);
+        std::swap(_nRows, other._nRows);
+        std::swap(_D, other._D);
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        std::swap(_capacity, other._capacity);
+        _rowIndex.swap(other._rowIndex);
+    }
+
+    /**
+		Funzione helper per la rimozioni di tutti gli elementi della matrice
+
+		@brief eliminazione di tutti gli elementi
+	*/
+    void clear(){
+        destroy(_data, _size, _capacity);
+
+        // azzero tutti i valori, cosi sono in una condizione coerente a fine clear
+		_data = nullptr;
+		_size = 0;
+        _capacity = 0;
+        _nCols = 0;
+        _nRows = 0;
+        _rowIndex.clear();
+    }
+
+    /**
+		Funzione helper privata per aggiungere un elemento nella matrice sparsa.
+		L'elemento viene inserito rispettando le coordinate (i,j) in ordine
+		crescente. Se la cella è già inizializzata sostituisce soltanto il valore.
+		La posizione viene trovata con una ricerca binaria; se l'elemento segue
+		tutti quelli gia' inseriti viene accodato direttamente.
+
+		@brief Inserisce un elemento nella matrice
+
+		@param e elemento da inserire
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime) 
+	*/
+    void add(const element &e){
+        // controllo che mi abbia passato indici validi, altrimenti genero un'eccezione
+        if (e.i < _nRows && e.j < _nCols){
+
+            // caso frequente: inserimento ordinato, accodo senza cercare
+            if(_size == 0 || less(_data[_size - 1], e.i, e.j)){
+                insert(_size, e);
+                S::onInsert(0, 0);
+                return;
+            }
+
+            size_type steps = 0;
+            size_type pos = lower_bound(e.i, e.j, steps);
+
+            // sto inserendo un elemento in una posizione che esiste già, lo sovrascrivo
+            if(pos < _size && _data[pos].i == e.i && _data[pos].j == e.j){
+                _data[pos].value = e.value;
+                S::onOverwrite(steps);
+                return; // non aumento size perchè non ho realmente aggiunto un elemento
+            }
+
+            insert(pos, e);
+            S::onInsert(steps, _size - 1 - pos);
+        }
+        else
+            throw index_out_of_bounds_exception();
+	}
+
+    /**
+		@brief scrive zeri da from fino a to, per allineare la sezione successiva
+	*/
+    static void pad(std::ofstream &out, const uint64_t from, const uint64_t to){
+        static const char zeros[sm_file_header::alignment] = {};
+        out.write(zeros, static_cast<std::streamsize>(to - from));
+    }
+
+    /**
+		Funzione helper che scrive nel file il campo get(e) di tutti gli
+		elementi, a blocchi di 4096 valori.
+
+		@brief scrittura di un array del formato binario
+	*/
+    template <typename V, typename F>
+    void write_array(std::ofstream &out, F get) const {
+        const size_type block = 4096;
+        std::vector<V> buffer(std::min(block, _size));
+
+        for(size_type k = 0; k < _size; k += block){
+            const size_type n = std::min(block, _size - k);
+            for(size_type l = 0; l < n; ++l)
+                buffer[l] = get(_data[k + l]);
+            out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(n * sizeof(V)));
+        }
+    }
+
+
+public:
+    /**
+        @brief Costruttore secondario
+
+        Costruttore secondario. Permette di istanziare una matrice sparsa con una 
+        data dimensione e un valore di default.
+
+        @param r numero di righe della matrice
+        @param c numero di colonne della matrice
+        @param dv valore di default degli elementi della matrice
+        @param alloc allocatore da usare per gli elementi
+    */
+	SparseMatrix(const sm_size r,const sm_size c, const value_type &dv, const allocator_type &alloc = allocator_type()) 
+        : _alloc(alloc), _data(nullptr), _D(dv), _size(0), _capacity(0), _nRows(r), _nCols(c), _rowIndex(alloc) {}
+
+
+	/**
+		@brief Distruttore (METODO FONDAMENTALE)
+
+		Distruttore. Rimuove la memoria allocata dalla matrice sparsa.
+	**/
+	~SparseMatrix(){
+        clear();
+    }
+
+	/**
+		@brief Operatore di assegnamento (METODO FONDAMENTALE)
+
+        Operatore di assegnamento. Permette la copia tra dbuffer.
 		
-		// Solo se serve anche const_iterator aggiungere le seguenti definizioni
-		friend class const_iterator;
+		@param other matrice sparsa da copiare
+		@return reference a this
 
-		/** 
-		 	Ridefinizione dell'operatore di uguaglianza tra iteratore e const_iterator
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	SparseMatrix& operator=(const SparseMatrix &other){
+		if(this != &other){
+            typedef typename element_traits::propagate_on_container_copy_assignment propagate;
 
-			@brief Operatore di uguaglianza con const_iterator
+			// copio l'altra matrice con l'allocatore che this deve avere dopo l'assegnamento
+			SparseMatrix tmp(other, propagate::value ? other.get_allocator() : get_allocator());
+            // swappo tutti i valori
+            swap_allocator(this -> _alloc, tmp._alloc, propagate());
+            swap_content(tmp);
 
-			@param un iteratore const_iterator other
-			@return Risultato dell'uguaglianza
-		*/
-		bool operator==(const const_iterator &other) const {
-			return _nPtr == other._nPtr;
+            // la copia e' stata fatta da tmp, attribuisco a this allocazione e copia
+            if(_size > 0)
+                S::onAllocate(_size);
+            S::onCopy(_size);
 		}
 
-		/** 
-		 	Ridefinizione dell'operatore di diseguaglianza tra iteratore e const_iterator
+		return *this;
+	}
 
-			@brief Operatore di uguaglianza con const_iterator
 
-			@param un iteratore const_iterator other
-			@return Risultato della diseguaglianza
-		*/
-		bool operator!=(const const_iterator &other) const {
-			return _nPtr != other._nPtr;
+	/**
+		@brief Operatore di assegnamento per spostamento
+
+        Operatore di assegnamento per spostamento. Se l'allocatore si propaga
+        (come std::allocator) o e' uguale a quello di other, prende l'array di
+        other senza copiare nulla; altrimenti copia gli elementi con il proprio
+        allocatore. other rimane una matrice vuota valida.
+
+		@param other matrice sparsa da spostare
+		@return reference a this
+
+		@throw eccezione di allocazione di memoria (runtime), solo se gli allocatori sono diversi
+	*/
+	SparseMatrix& operator=(SparseMatrix &&other)
+        noexcept(element_traits::propagate_on_container_move_assignment::value && nothrow_move){
+		if(this != &other){
+            typedef typename element_traits::propagate_on_container_move_assignment propagate;
+
+            if(propagate::value || _alloc == other._alloc){
+                SparseMatrix tmp(std::move(other));
+                swap_allocator(this -> _alloc, tmp._alloc, propagate());
+                swap_content(tmp);
+            }
+            else
+                *this = static_cast<const SparseMatrix&>(other);
 		}
 
-		// Solo se serve anche const_iterator aggiungere le precedenti definizioni
+		return *this;
+	}
 
-	private:
-		//Dati membro
-        node *_nPtr; // puntatore ai nodi altrimenti l'iteratore non può accedere ai dati
+	/**
+        @brief Move constructor
 
-		// La classe container deve essere messa friend dell'iteratore per poter
-		// usare il costruttore di inizializzazione.
-		friend class SparseMatrix; // !!! Da cambiare il nome!
+		Costruttore per spostamento. Prende l'array degli elementi di other
+		senza copiarli; other rimane una matrice vuota valida.
+
+		@param other matrice sparsa da spostare
+	*/
+    SparseMatrix(SparseMatrix &&other) noexcept(nothrow_move)
+        : _alloc(std::move(other._alloc)), _data(other._data), _D(std::move(other._D)), _size(other._size),
+          _capacity(other._capacity), _nRows(other._nRows), _nCols(other._nCols), _rowIndex(std::move(other._rowIndex)){
+        other._data = nullptr;
+        other._size = 0;
+        other._capacity = 0;
+        other._rowIndex.clear();
+    }
 
-		// Costruttore privato di inizializzazione usato dalla classe container
-		// tipicamente nei metodi begin e end
-		iterator(node *n) : _nPtr(n){}
-	}; // classe iterator
-	
 	/**
-		Ritorna l'iteratore all'inizio della sequenza dati
-	
-		@return iteratore all'inizio della sequenza
+		@brief Scambio di due matrici
+
+		Scambia il contenuto di this con quello di other in O(1), senza
+		copiare gli elementi. Gli allocatori vengono scambiati solo se
+		l'allocatore lo prevede, altrimenti devono essere uguali.
+
+		@param other matrice sparsa con cui scambiare il contenuto
 	*/
-	iterator begin() {
-		return iterator(_head);
-	}
-	
+    void swap(SparseMatrix &other) noexcept(nothrow_move){
+        swap_allocator(_alloc, other._alloc, typename element_traits::propagate_on_container_swap());
+        swap_content(other);
+    }
+
 	/**
-		Ritorna l'iteratore alla fine della sequenza dati
-	
-		@return iteratore alla fine della sequenza
+        @brief Copy constructor (METODO FONDAMENTALE)
+
+		Costruttore di copia. Permette di istanziare una matrice sparsa 
+        con i valori presi da un altra matrice spara.
+
+		@param other matrice sparsa da copiare
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
 	*/
-	iterator end() {
-		return iterator(nullptr);
-	}
-	
-	
+    SparseMatrix(const SparseMatrix &other)
+        : SparseMatrix(other, element_traits::select_on_container_copy_construction(other._alloc)) {}
+
 	/**
-		Iteratore costante della lista
+        @brief Copy constructor con allocatore
 
-		@brief Iteratore costante della lista
+		Costruttore di copia che usa l'allocatore dato invece di quello
+		dell'altra matrice. L'altra matrice e' gia' ordinata, quindi l'array
+		viene allocato una sola volta e gli elementi copiati in coda, in O(n).
+
+		@param other matrice sparsa da copiare
+		@param alloc allocatore da usare per gli elementi
+
+		@throw eccezione di allocazione di memoria (runtime)
 	*/
-	class const_iterator {
-		//	
-	public:
-		typedef std::forward_iterator_tag iterator_category;
-		typedef element value_type;
-		typedef ptrdiff_t difference_type;
-		typedef const element* pointer;
-		typedef const element & reference;
+    SparseMatrix(const SparseMatrix &other, const allocator_type &alloc)
+        : _alloc(alloc), _data(nullptr), _D(other._D), _size(0), _capacity(0), _nRows(other._nRows),
+          _nCols(other._nCols), _rowIndex(other._rowIndex, alloc){
+
+			try {
+				_data = allocate(other._size);
+				_capacity = other._size;
+				for(; _size < other._size; ++_size)
+					construct(_data + _size, other._data[_size]);
+				S::onCopy(_size);
+			}
+			catch(...) { 
+				clear(); // se qualche copia non va a buon fine svuoto tutta la matrice
+				throw;
+			}
+    }
+    
+        
+    /**
+		@brief Costruttore secondario
+
+		Costruttore secondario che costruisce la matrice sparsa a partire
+		da un'altra matrice sparsa di tipo generico Q, eventualmente con un
+		diverso tipo di coordinate J. Gli elementi di other sono gia' ordinati:
+		vengono convertiti e copiati in coda in O(n).
+
+		@param other matrice sparsa da copiare
+		@param alloc allocatore da usare per gli elementi
+
+		@throw index_out_of_bounds_exception se le dimensioni di other non sono rappresentabili con I
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+	template <typename Q, typename B, typename J, typename R>
+	SparseMatrix(const SparseMatrix<Q, B, J, R> &other, const allocator_type &alloc = allocator_type())
+        : _alloc(alloc), _data(nullptr), _size(0), _capacity(0), _nRows(0), _nCols(0), _rowIndex(alloc) {
+        // sfrutto gli operatori
+        typename SparseMatrix<Q, B, J, R> :: const_iterator ib, ie;
+
+        ib = other.begin();
+        ie = other.end();
+
+        // tutte le coordinate sono minori delle dimensioni, quindi basta controllare queste
+        if(static_cast<J>(static_cast<sm_size>(other.getNumRows())) != other.getNumRows() ||
+           static_cast<J>(static_cast<sm_size>(other.getNumCols())) != other.getNumCols())
+            throw index_out_of_bounds_exception();
+
+        _nCols = static_cast<sm_size>(other.getNumCols());
+        _nRows = static_cast<sm_size>(other.getNumRows());
+		_D = static_cast<value_type>(other.getDefaultValue()); // casto il valore di default 
+
+		try{
+			_data = allocate(other.getNumElement());
+			_capacity = other.getNumElement();
+			for(; ib != ie; ++ib, ++_size)
+				element_traits::construct(_alloc, _data + _size, static_cast<sm_size>(ib -> i), static_cast<sm_size>(ib -> j),
+				                          static_cast<value_type>(ib -> value));
+			S::onCopy(_size);
+
+			if(other.hasRowIndex())
+				setRowIndex(true);
+        }
+		catch(...) { 
+			clear(); // se qualche copia non va a buon fine svuoto tutta la matrice
+			throw;
+		}
+	}
+
+    /**
+        @brief Costruttore da un intervallo di terne
+
+        Costruttore secondario che istanzia una matrice sparsa e la riempie
+        con gli elementi dell'intervallo [first, last), vedi assign.
+
+        @param r numero di righe della matrice
+        @param c numero di colonne della matrice
+        @param dv valore di default degli elementi della matrice
+        @param first inizio dell'intervallo
+        @param last fine dell'intervallo
+        @param policy politica per le coordinate duplicate
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+    */
+    template <typename InputIt>
+    SparseMatrix(const sm_size r, const sm_size c, const value_type &dv, InputIt first, InputIt last,
+                 const duplicate_policy policy = last_wins)
+        : SparseMatrix(r, c, dv) {
+        assign(first, last, policy);
+    }
+
+    /**
+        @brief Costruttore da un'espressione
+
+        Valuta un'espressione come alpha*A + beta*B - C (vedi sm_binary_expr)
+        con una sola fusione a k vie degli array ordinati delle k matrici
+        coinvolte, senza matrici intermedie. Il risultato viene allocato una
+        sola volta e usa l'allocatore della prima matrice dell'espressione.
+        Il valore di default e' l'espressione calcolata sui valori di default.
+
+        @param expr espressione da valutare
+        @param dropDefault se true non memorizza i risultati uguali al nuovo valore di default
+
+		@throw eccezione di allocazione di memoria (runtime)
+    */
+    template <typename E>
+    SparseMatrix(const E &expr, const bool dropDefault = false,
+                 typename std::enable_if<std::is_same<typename E::matrix_type, SparseMatrix>::value>::type * = nullptr)
+        : SparseMatrix(expr.getNumRows(), expr.getNumCols(), expr.getDefaultValue(), expr.leftmost().get_allocator()) {
+        // la matrice e' gia' costruita: se fuse fallisce il distruttore libera gli elementi costruiti
+        fuse(expr, dropDefault);
+    }
+
+    /**
+        @brief Assegnamento da un'espressione
+
+        Valuta l'espressione in una nuova matrice e la sposta in this, quindi
+        l'espressione puo' contenere this (ad esempio A = A + B).
+
+        @param expr espressione da valutare
+        @return reference a this
+
+		@throw eccezione di allocazione di memoria (runtime)
+    */
+    template <typename E>
+    typename std::enable_if<std::is_same<typename E::matrix_type, SparseMatrix>::value, SparseMatrix&>::type
+    operator=(const E &expr){
+        return *this = SparseMatrix(expr);
+    }
+
+    /**
+		@brief Inserimento di massa con politica per i duplicati
+
+        Sostituisce il contenuto della matrice con gli elementi dell'intervallo
+        [first, last), non ordinato. Gli elementi possono essere element (o
+        qualunque struttura con campi i, j, value) oppure std::tuple (i, j, valore).
+        Gli indici sono controllati in una sola passata prima di modificare la
+        matrice, poi gli elementi vengono ordinati in O(n log n) e l'array
+        viene costruito con una sola allocazione.
+
+		@param first inizio dell'intervallo
+		@param last fine dell'intervallo
+		@param policy last_wins tiene l'ultimo valore, sum somma i duplicati
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    template <typename InputIt>
+    void assign(InputIt first, InputIt last, const duplicate_policy policy = last_wins){
+        if(policy == sum)
+            assign(first, last, add_values());
+        else
+            assign(first, last, keep_last());
+    }
+
+    /**
+		@brief Inserimento di massa con riduzione personalizzata dei duplicati
+
+        Come assign con politica, ma i valori con le stesse coordinate vengono
+        combinati, nell'ordine dell'intervallo, con reduce(accumulato, nuovo).
+
+		@param first inizio dell'intervallo
+		@param last fine dell'intervallo
+		@param reduce funzione binaria che combina due valori duplicati
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    template <typename InputIt, typename Reducer>
+    void assign(InputIt first, InputIt last, Reducer reduce){
+        std::vector<triplet> t;
+        const size_type n = sorted_triplets(first, last, reduce, t);
+        replace(t.begin(), n);
+    }
+
+    /**
+		@brief Inserimento di massa di elementi gia' ordinati
+
+        Sostituisce il contenuto della matrice con gli elementi dell'intervallo
+        [first, last), che devono essere ordinati per (i,j) crescenti e senza
+        coordinate ripetute, come quelli di un const_iterator. Gli elementi
+        possono essere element (o qualunque struttura con campi i, j, value)
+        oppure std::tuple (i, j, valore). Una prima passata controlla indici e
+        ordinamento senza modificare la matrice, la seconda costruisce l'array
+        con una sola allocazione: niente ordinamento e niente copie intermedie.
+
+		@param first inizio dell'intervallo
+		@param last fine dell'intervallo
+
+		@throw index_out_of_bounds_exception
+		@throw unsorted_range_exception se l'intervallo non e' ordinato o ha duplicati
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    template <typename ForwardIt>
+    void assign_sorted(ForwardIt first, ForwardIt last){
+        size_type n = 0;
+        unsigned long long pi = 0, pj = 0;
+        for(ForwardIt k = first; k != last; ++k, ++n){
+            const triplet t = to_triplet(*k);
+            if(t.i >= _nRows || t.j >= _nCols)
+                throw index_out_of_bounds_exception();
+            if(n > 0 && (t.i < pi || (t.i == pi && t.j <= pj)))
+                throw unsorted_range_exception();
+            pi = t.i;
+            pj = t.j;
+        }
+
+        replace(first, n);
+    }
+
+    /**
+		@brief Inserimento di un blocco di elementi con politica per i duplicati
+
+        Inserisce gli elementi dell'intervallo [first, last), non ordinato,
+        mantenendo quelli gia' presenti: equivale a chiamare add per ogni
+        elemento, ma il blocco viene ordinato in O(n log n) e fuso con gli
+        elementi della matrice in una sola passata O(nnz + n), con una sola
+        allocazione. Con last_wins un elemento del blocco sostituisce quello
+        presente, con sum i valori vengono sommati. In caso di eccezione la
+        matrice rimane invariata.
+
+		@param first inizio dell'intervallo
+		@param last fine dell'intervallo
+		@param policy last_wins tiene l'ultimo valore, sum somma i duplicati
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    template <typename InputIt>
+    void add_batch(InputIt first, InputIt last, const duplicate_policy policy = last_wins){
+        if(policy == sum)
+            add_batch(first, last, add_values());
+        else
+            add_batch(first, last, keep_last());
+    }
+
+    /**
+		@brief Inserimento di un blocco di elementi con riduzione personalizzata
+
+        Come add_batch con politica, ma i valori con le stesse coordinate,
+        compreso quello gia' presente nella matrice, vengono combinati con
+        reduce(accumulato, nuovo).
+
+		@param first inizio dell'intervallo
+		@param last fine dell'intervallo
+		@param reduce funzione binaria che combina due valori duplicati
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    template <typename InputIt, typename Reducer>
+    void add_batch(InputIt first, InputIt last, Reducer reduce){
+        std::vector<triplet> t;
+        const size_type n = sorted_triplets(first, last, reduce, t);
+        if(n > 0)
+            merge(t, n, reduce);
+    }
+
+    /**
+		@brief Inserimento di un elemento nella matrice
+
+        Inserisce un elemento nella matrice in posizione (i,j) con valore value
+		L'elemento viene inserito rispettando le coordinate (i,j) in ordine
+		crescente. Se la cella è già inizializzata sostituisce soltanto il valore
+
+		@param value valore da inserire
+		@param ii indice della riga in cui inserire l'elemento        
+		@param jj indice della colonna in cui inserire l'elemento  
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    void add(const sm_size ii, const sm_size jj, const value_type& value){
+        element tmpE(ii,jj,value);
+        add(tmpE); // richiamo il metodo privato di add 
+	}
+	
+    /**
+		@brief Accesso ai dati in lettura
+
+        Metodo per leggere il valore dell'elemento in posizione (i,j) della
+        matrice. Se l'elemento non è inserito ritorna il valore di default.
+        L'elemento viene cercato con una ricerca binaria sull'array ordinato.
+
+		@param ii indice della riga    
+		@param jj indice della colonna
+
+        @return valore dell'elemento in posizione (ii,jj)
+		
+		@throw index_out_of_bounds_exception
+	*/
+    const value_type& operator()(const sm_size ii,const sm_size jj) const {
+        if (ii < _nRows && jj < _nCols){
+
+            size_type steps = 0;
+            size_type pos = lower_bound(ii, jj, steps);
+            S::onLookup(steps);
+            if(pos < _size && _data[pos].i == ii && _data[pos].j == jj)
+                return _data[pos].value;
+
+            return _D; // non è salvato quindi ritorno il valore di default
+        }
+        else
+            throw index_out_of_bounds_exception();
+        
+	}
+    
+   
+    /**
+		@brief Prodotto matrice-vettore
+
+        Calcola y = A x, dove x ha getNumCols() elementi e y getNumRows().
+        Il valore di default contribuisce a tutte le righe: ogni cella non
+        inserita vale _D, quindi y[i] = _D * somma(x) + somma((a_ij - _D) * x[j])
+        sugli elementi inseriti della riga i.
+        Con threads > 1 le righe vengono divise in blocchi con circa lo stesso
+        numero di elementi, uno per thread; threads = 0 usa un thread per core.
+        Richiede che T supporti +, -, * e ==.
+
+		@param x vettore di ingresso, getNumCols() elementi
+		@param y vettore di uscita, getNumRows() elementi
+		@param threads numero di thread da usare
+
+		@throw std::system_error se non e' possibile creare un thread
+	*/
+    void multiply(const value_type *x, value_type *y, unsigned int threads = 1) const {
+        const bool zeroDefault = (_D == value_type());
+        value_type base = value_type();
+
+        if(!zeroDefault){
+            value_type sum = value_type();
+            for(sm_size c = 0; c < _nCols; ++c)
+                sum += x[c];
+            base = _D * sum;
+        }
+
+        std::vector<sm_size> rows;
+        std::vector<size_type> elems;
+        threads = partitionRows(threads, rows, elems);
+
+        run_parallel(threads, [&](const unsigned int t){
+            multiply_rows(x, y, rows[t], rows[t + 1], elems[t], elems[t + 1], base, zeroDefault);
+        });
+    }
+
+    /**
+		@brief Prodotto matrice-vettore
+
+        Calcola y = A x, vedi multiply(const value_type*, value_type*, unsigned int).
+
+		@param x vettore di ingresso, getNumCols() elementi
+		@param threads numero di thread da usare
+		@return vettore y di getNumRows() elementi
+
+		@throw dimension_mismatch_exception se x non ha getNumCols() elementi
+		@throw std::system_error se non e' possibile creare un thread
+	*/
+    std::vector<value_type> multiply(const std::vector<value_type> &x, const unsigned int threads = 1) const {
+        if(x.size() != _nCols)
+            throw dimension_mismatch_exception();
+
+        std::vector<value_type> y(_nRows);
+        multiply(x.data(), y.data(), threads);
+        return y;
+    }
+
+    /**
+		@brief Lettura di molte celle
+
+        Scrive in values[q] il valore della cella coords[q], per q in [0, k),
+        come operator() ma con una sola fusione: le richieste vengono
+        ordinate per coordinate (ricordando la loro posizione) e scorse
+        insieme all'array degli elementi, avanzando con una ricerca
+        esponenziale a partire dall'ultima posizione trovata. Il costo e'
+        O(k log k + k log(nnz / k)): lineare se le richieste sono fitte,
+        logaritmico per richiesta se sono poche. Con threads > 1 le richieste
+        vengono divise in blocchi, ognuno ordinato e risolto da un thread;
+        threads = 0 usa un thread per core.
+
+		@param coords coordinate (riga, colonna) delle celle da leggere
+		@param k numero di celle
+		@param values valori letti, k elementi, nell'ordine di coords
+		@param threads numero di thread da usare
+
+		@throw index_out_of_bounds_exception prima di scrivere qualunque valore
+		@throw eccezione di allocazione di memoria (runtime)
+		@throw std::system_error se non e' possibile creare un thread
+	*/
+    void lookup_batch(const std::pair<sm_size, sm_size> *coords, const size_type k, value_type *values,
+                      unsigned int threads = 1) const {
+        for(size_type q = 0; q < k; ++q)
+            if(coords[q].first >= _nRows || coords[q].second >= _nCols)
+                throw index_out_of_bounds_exception();
+
+        if(threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if(threads > k)
+            threads = static_cast<unsigned int>(k);
+        if(threads == 0)
+            threads = 1;
+
+        std::vector<std::exception_ptr> errors(threads);
+        run_parallel(threads, [&](const unsigned int t){
+            try{
+                lookup_block(coords, k * t / threads, k * (t + 1) / threads, values);
+            }
+            catch(...){
+                errors[t] = std::current_exception();
+            }
+        });
+
+        for(unsigned int t = 0; t < threads; ++t)
+            if(errors[t])
+                std::rethrow_exception(errors[t]);
+    }
+
+    /**
+		@brief Lettura di molte celle
+
+        Vedi lookup_batch(const std::pair<sm_size, sm_size>*, size_type, value_type*, unsigned int).
+
+		@param coords coordinate (riga, colonna) delle celle da leggere
+		@param threads numero di thread da usare
+		@return valori letti, nell'ordine di coords
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime)
+		@throw std::system_error se non e' possibile creare un thread
+	*/
+    std::vector<value_type> lookup_batch(const std::vector<std::pair<sm_size, sm_size> > &coords,
+                                         const unsigned int threads = 1) const {
+        std::vector<value_type> values(coords.size(), _D);
+        lookup_batch(coords.data(), coords.size(), values.data(), threads);
+        return values;
+    }
+
+    /**
+		@brief Prodotto tra matrici sparse
+
+        Calcola this * other con l'algoritmo di Gustavson, riga per riga.
+        Una prima passata simbolica conta gli elementi di ogni riga del
+        risultato, cosi' l'array del risultato viene allocato una sola volta;
+        la passata numerica accumula ogni riga in un vettore denso e scrive gli
+        elementi direttamente nella loro posizione. Con threads > 1 le righe
+        vengono divise tra i thread in blocchi con circa lo stesso numero di
+        elementi; threads = 0 usa un thread per core.
+        Entrambe le matrici devono avere valore di default T(): con un valore
+        di default diverso il risultato sarebbe denso.
+
+		@param other matrice da moltiplicare a destra
+		@param threads numero di thread da usare
+		@return matrice prodotto, getNumRows() x other.getNumCols()
+
+		@throw dimension_mismatch_exception se getNumCols() != other.getNumRows()
+		@throw default_value_exception se un valore di default non e' T()
+		@throw eccezione di allocazione di memoria (runtime)
+		@throw std::system_error se non e' possibile creare un thread
+	*/
+    SparseMatrix multiply(const SparseMatrix &other, const unsigned int threads = 1) const {
+        if(_nCols != other._nRows)
+            throw dimension_mismatch_exception();
+        if(!(_D == value_type()) || !(other._D == value_type()))
+            throw default_value_exception();
+
+        const sm_size none = static_cast<sm_size>(-1);
+        const std::vector<size_type> bRow = other.rowStarts();
+        std::vector<sm_size> rows;
+        std::vector<size_type> elems;
+        const unsigned int blocks = partitionRows(threads, rows, elems);
+
+        // passata simbolica: numero di colonne distinte di ogni riga del risultato
+        std::vector<size_type> start(static_cast<size_type>(_nRows) + 1, 0);
+        run_parallel(blocks, [&](const unsigned int t){
+            std::vector<sm_size> mark(other._nCols, none);
+            size_type k = elems[t];
+            for(sm_size r = rows[t]; r < rows[t + 1]; ++r){
+                size_type count = 0;
+                for(; k < elems[t + 1] && _data[k].i == r; ++k)
+                    for(size_type l = bRow[_data[k].j]; l < bRow[_data[k].j + 1]; ++l)
+                        if(mark[other._data[l].j] != r){
+                            mark[other._data[l].j] = r;
+                            ++count;
+                        }
+                start[r + 1] = count;
+            }
+        });
+        for(sm_size r = 0; r < _nRows; ++r)
+            start[r + 1] += start[r];
+
+        SparseMatrix result(_nRows, other._nCols, value_type(), get_allocator());
+        result._data = result.allocate(start[_nRows]);
+        result._capacity = start[_nRows];
+
+        // passata numerica: ogni blocco costruisce i propri elementi a partire da start[rows[t]]
+        std::vector<size_type> built(blocks, 0);
+        std::vector<std::exception_ptr> errors(blocks);
+        run_parallel(blocks, [&](const unsigned int t){
+            try{
+                std::vector<value_type> acc(other._nCols);
+                std::vector<sm_size> mark(other._nCols, none);
+                std::vector<sm_size> cols;
+                size_type k = elems[t];
+                element *out = result._data + start[rows[t]];
+
+                for(sm_size r = rows[t]; r < rows[t + 1]; ++r){
+                    cols.clear();
+                    for(; k < elems[t + 1] && _data[k].i == r; ++k)
+                        for(size_type l = bRow[_data[k].j]; l < bRow[_data[k].j + 1]; ++l){
+                            const sm_size j = other._data[l].j;
+                            if(mark[j] != r){
+                                mark[j] = r;
+                                acc[j] = _data[k].value * other._data[l].value;
+                                cols.push_back(j);
+                            }
+                            else
+                                acc[j] += _data[k].value * other._data[l].value;
+                        }
+
+                    std::sort(cols.begin(), cols.end());
+                    for(size_t c = 0; c < cols.size(); ++c, ++built[t])
+                        element_traits::construct(result._alloc, out + built[t], r, cols[c], acc[cols[c]]);
+                }
+            }
+            catch(...){
+                errors[t] = std::current_exception();
+            }
+        });
+
+        for(unsigned int t = 0; t < blocks; ++t){
+            if(errors[t]){
+                // distruggo gli elementi costruiti da ogni blocco, poi il distruttore libera l'array
+                for(unsigned int b = 0; b < blocks; ++b)
+                    for(size_type k = 0; k < built[b]; ++k)
+                        element_traits::destroy(result._alloc, result._data + start[rows[b]] + k);
+                std::rethrow_exception(errors[t]);
+            }
+        }
+
+        result._size = start[_nRows];
+        return result;
+    }
+
+    /**
+		@brief Operazione elemento per elemento
+
+        Calcola la matrice C con C(i,j) = op(this(i,j), other(i,j)) con una sola
+        fusione dei due array ordinati, in O(nnz + other.nnz). Il valore di
+        default di C e' op(_D, other._D); le celle inserite in una sola delle
+        due matrici vengono combinate con il valore di default dell'altra.
+        L'array del risultato viene allocato una sola volta.
+
+		@param other seconda matrice, delle stesse dimensioni
+		@param op funzione binaria da applicare
+		@param dropDefault se true non memorizza i risultati uguali al nuovo valore di default
+		@return matrice risultato
+
+		@throw dimension_mismatch_exception se le dimensioni sono diverse
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    template <typename F>
+    SparseMatrix zip_with(const SparseMatrix &other, F op, const bool dropDefault = false) const {
+        if(_nRows != other._nRows || _nCols != other._nCols)
+            throw dimension_mismatch_exception();
+
+        SparseMatrix result(_nRows, _nCols, op(_D, other._D), get_allocator());
+        const value_type &d = result._D;
+
+        result._data = result.allocate(_size + other._size);
+        result._capacity = _size + other._size;
+
+        size_type p = 0, q = 0;
+        while(p < _size || q < other._size){
+            const element *e;
+            value_type v;
+
+            if(q == other._size || (p < _size && less(_data[p], other._data[q].i, other._data[q].j))){
+                e = _data + p++;
+                v = op(e -> value, other._D);
+            }
+            else if(p == _size || less(other._data[q], _data[p].i, _data[p].j)){
+                e = other._data + q++;
+                v = op(_D, e -> value);
+            }
+            else{
+                e = _data + p++;
+                v = op(e -> value, other._data[q++].value);
+            }
+
+            if(dropDefault && v == d)
+                continue;
+
+            // se la costruzione fallisce il distruttore di result libera gli elementi gia' costruiti
+            element_traits::construct(result._alloc, result._data + result._size, e -> i, e -> j, v);
+            ++result._size;
+        }
+
+        return result;
+    }
+
+    /**
+		@brief Trasposta della matrice
+
+        Costruisce la trasposta con un counting sort sugli indici di colonna,
+        in O(nnz + getNumCols()). Gli elementi sono gia' ordinati per riga,
+        quindi dentro ogni colonna arrivano in ordine di riga e il risultato
+        e' ordinato senza ulteriori confronti. L'indice delle righe viene
+        attivato sulla trasposta se e' attivo sulla matrice.
+
+		@return matrice trasposta, getNumCols() x getNumRows()
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    SparseMatrix transpose() const {
+        SparseMatrix result(_nCols, _nRows, _D, get_allocator());
+
+        std::vector<size_type> start(static_cast<size_type>(_nCols) + 1, 0);
+        for(size_type k = 0; k < _size; ++k)
+            ++start[_data[k].j + 1];
+        for(sm_size c = 0; c < _nCols; ++c)
+            start[c + 1] += start[c];
+
+        // posizione di origine di ogni elemento della trasposta, cosi' gli
+        // elementi vengono costruiti in ordine e result._size resta consistente
+        std::vector<size_type> source(_size);
+        for(size_type k = 0; k < _size; ++k)
+            source[start[_data[k].j]++] = k;
+
+        result._data = result.allocate(_size);
+        result._capacity = _size;
+        for(; result._size < _size; ++result._size){
+            const element &e = _data[source[result._size]];
+            element_traits::construct(result._alloc, result._data + result._size, e.j, e.i, e.value);
+        }
+
+        if(hasRowIndex())
+            result.setRowIndex(true);
+
+        return result;
+    }
+
+    /**
+		@brief Attivazione dell'indice delle righe
+
+        Attiva o disattiva l'indice delle righe. L'indice memorizza la posizione
+        del primo elemento di ogni riga, cosi' lettura e inserimento cercano
+        soltanto nella riga interessata: il costo dipende dalla lunghezza della
+        riga e non dal numero totale di elementi. Ogni inserimento aggiorna le
+        posizioni delle righe successive, quindi conviene con inserimenti
+        ordinati per riga. Occupa (numero di righe + 1) interi.
+
+		@param enable true per attivare l'indice, false per liberarlo
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    void setRowIndex(const bool enable){
+        if(!enable){
+            index_vector(_rowIndex.get_allocator()).swap(_rowIndex); // libero anche la memoria
+            return;
+        }
+
+        index_vector index(static_cast<size_type>(_nRows) + 1, 0, _rowIndex.get_allocator());
+        for(size_type k = 0; k < _size; ++k)
+            ++index[_data[k].i + 1];
+        for(sm_size r = 0; r < _nRows; ++r)
+            index[r + 1] += index[r];
+
+        _rowIndex.swap(index);
+    }
+
+    /**
+		@brief stato dell'indice delle righe
+
+		@return true se l'indice delle righe e' attivo
+	*/
+    bool hasRowIndex() const{
+        return !_rowIndex.empty();
+    }
+
+    /**
+		@brief Salvataggio in formato binario
+
+        Scrive la matrice nel formato descritto da sm_file_header, che
+        MappedMatrix puo' mappare in memoria senza copie. Gli array vengono
+        scritti a blocchi, senza copiare la matrice. Richiede un tipo T
+        banalmente copiabile.
+
+		@param path percorso del file da creare (sovrascritto se esiste)
+
+		@throw matrix_file_exception se il file non puo' essere scritto
+	*/
+    void save(const std::string &path) const {
+        static_assert(std::is_trivially_copyable<value_type>::value, "save requires a trivially copyable T");
+
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        if(!out)
+            throw matrix_file_exception("Cannot open matrix file for writing");
+
+        const sm_file_header h = sm_file_header::make(sizeof(sm_size), sizeof(value_type), _nRows, _nCols, _size);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        pad(out, sizeof(h), h.defaultOffset);
+        out.write(reinterpret_cast<const char*>(&_D), sizeof(value_type));
+        pad(out, h.defaultOffset + sizeof(value_type), h.rowsOffset);
+        write_array<sm_size>(out, [](const element &e){ return e.i; });
+        pad(out, h.rowsOffset + _size * sizeof(sm_size), h.colsOffset);
+        write_array<sm_size>(out, [](const element &e){ return e.j; });
+        pad(out, h.colsOffset + _size * sizeof(sm_size), h.valuesOffset);
+        write_array<value_type>(out, [](const element &e){ return e.value; });
+
+        out.flush();
+        if(!out)
+            throw matrix_file_exception("Cannot write matrix file");
+    }
+
+    /**
+		@brief statistiche della strumentazione
+
+        Disponibile se la politica S fornisce stats(); con no_instrumentation
+        le statistiche sono sempre nulle.
+
+		@return statistiche raccolte dalla politica di strumentazione
+	*/
+    sm_stats getStats() const{
+        return S::stats();
+    }
+
+    /**
+		@brief azzera le statistiche della strumentazione
+	*/
+    void resetStats(){
+        S::resetStats();
+    }
+
+    /**
+		@brief allocatore della matrice
+
+		@return copia dell'allocatore usato dalla matrice
+	*/
+    allocator_type get_allocator() const{
+        return allocator_type(_alloc);
+    }
+
+    /**
+		@brief numero di righe della matrice
+
+		Ritorna il numero di righe della matrice
+
+		@return numero di righe della matrice
+	*/
+    sm_size getNumRows() const{
+        return _nRows;
+    }
+
+    /**
+		@brief numero di colonne della matrice
+
+		Ritorna il numero di colonne della matrice
+
+		@return numero di colonne della matrice
+	*/
+    sm_size getNumCols() const{
+        return _nCols;
+    }
+
+    
+	/**
+		@brief numero di elementi inseriti nella matrice
+
+		Ritorna il numero di elementi inseriti nella matrice sparsa
+
+		@return numero di elementi inseriti
+	*/
+    size_type getNumElement() const{
+        return _size;
+    }
+
+	/**
+		@brief valore di default della matrice
+
+		Ritorna il valore di default della matrice
+
+		@return valore di default
+	*/
+    const value_type& getDefaultValue() const{
+        return _D;
+    }
+
+
+
+    // ------------- ITERATOR ----------------
+    class const_iterator; // forward declaration
+
+    /**
+		Iteratore della matrice
+
+		@brief Iteratore della matrice
+	*/
+	class iterator {
+		//	
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef element* pointer;
+		typedef element& reference;
+
+		/**
+			Costruttore dell'iteratore
+			@brief Setta il nodo a nullptr
+		*/
+		iterator() : _nPtr(nullptr) {}
+
+		/**
+			Copy constructor dell'iteratore
+
+			@brief copy constructor 
+
+			@param un altro iteratore costante other
+		*/		
+		iterator(const iterator &other) : _nPtr(other._nPtr) {}
+
+		/**
+			Ridefinizione operator =
+
+			@brief operatore di assegnamento
+			@param un altro iteratore costante other
+			@return riferimento all'iteratore
+		*/
+		iterator& operator=(const iterator &other) {
+			_nPtr = other._nPtr;
+            return *this;
+		}
+
+		/**
+			Distruttore dell'iteratore
+
+			@brief distruttore
+		*/
+		~iterator() {}
+
+		/** 
+			ritorna il dato riferito dall'iteratore (dereferenziamento)
+			
+			@brief operatore di deferenziamento
+
+			@return struct element
+		*/
+		reference operator*() const {
+			return *_nPtr;
+		}
+
+		/** 
+			ritorna il dato riferito dall'iteratore
+
+			@brief operatore ->
+
+			@return puntatore ad un element
+		*/
+		pointer operator->() const {
+			return _nPtr;
+		}
+
+		/** 
+			Operatore di post-incremento dell'iteratore
+
+			@brief operatore di post-incremento 
+
+			@return l'iteratore pre incremento
+		*/
+		iterator operator++(int) {
+			iterator tmp(*this);
+			++_nPtr;
+			return tmp;
+		}
+
+		/** 
+			Operatore di pre-incremento dell'iteratore
+
+			@brief operatore di pre-incremento 
+
+			@return l'iteratore incrementato
+		*/
+		iterator& operator++() {
+			++_nPtr;
+            return *this;
+		}
+
+		/** 
+		 	Ridefinizione dell'operatore di uguaglianza
+
+			@brief Operatore di uguaglianza
+
+			@param un altro iteratore costante other
+			@return Risultato dell'uguaglianza
+		*/
+		bool operator==(const iterator &other) const {
+			return _nPtr == other._nPtr;
+		}
+
+		/** 
+		 	Ridefinizione dell'operatore di diseguaglianza
+
+			@brief Operatore di uguaglianza
+
+			@param un altro iteratore costante other
+			@return Risultato della diseguaglianza
+		*/
+		bool operator!=(const iterator &other) const {
+			return _nPtr != other._nPtr;
+		}
+		
+		// Solo se serve anche const_iterator aggiungere le seguenti definizioni
+		friend class const_iterator;
+
+		/** 
+		 	Ridefinizione dell'operatore di uguaglianza tra iteratore e const_iterator
+
+			@brief Operatore di uguaglianza con const_iterator
+
+			@param un iteratore const_iterator other
+			@return Risultato dell'uguaglianza
+		*/
+		bool operator==(const const_iterator &other) const {
+			return _nPtr == other._nPtr;
+		}
+
+		/** 
+		 	Ridefinizione dell'operatore di diseguaglianza tra iteratore e const_iterator
+
+			@brief Operatore di uguaglianza con const_iterator
+
+			@param un iteratore const_iterator other
+			@return Risultato della diseguaglianza
+		*/
+		bool operator!=(const const_iterator &other) const {
+			return _nPtr != other._nPtr;
+		}
+
+		// Solo se serve anche const_iterator aggiungere le precedenti definizioni
+
+	private:
+		//Dati membro
+        element *_nPtr; // puntatore agli elementi altrimenti l'iteratore non può accedere ai dati
+
+		// La classe container deve essere messa friend dell'iteratore per poter
+		// usare il costruttore di inizializzazione.
+		friend class SparseMatrix; // !!! Da cambiare il nome!
+
+		// Costruttore privato di inizializzazione usato dalla classe container
+		// tipicamente nei metodi begin e end
+		iterator(element *n) : _nPtr(n){}
+	}; // classe iterator
+	
+	/**
+		Ritorna l'iteratore all'inizio della sequenza dati
+	
+		@return iteratore all'inizio della sequenza
+	*/
+	iterator begin() {
+		return iterator(_data);
+	}
+	
+	/**
+		Ritorna l'iteratore alla fine della sequenza dati
+	
+		@return iteratore alla fine della sequenza
+	*/
+	iterator end() {
+		return iterator(_data + _size);
+	}
+	
+	
+	/**
+		Iteratore costante della lista
+
+		@brief Iteratore costante della lista
+	*/
+	class const_iterator {
+		//	
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const element* pointer;
+		typedef const element & reference;
+
+		/**
+			Costruttore dell'iteratore costante
+			@brief Setta il nodo a nullptr
+		*/
+		const_iterator() : _nPtr(nullptr){}
+		
+		/**
+			Copy constructor dell'iteratore costante
+
+			@brief copy constructor 
+
+			@param un altro const_iterator other
+		*/	
+		const_iterator(const const_iterator &other) : _nPtr(other._nPtr){}
+
+		/**
+			Ridefinizione operator =
+
+			@brief operatore di assegnamento
+			@param un altro const_iterator other
+			@return riferimento all'iteratore
+		*/
+		const_iterator& operator=(const const_iterator &other) {
+			_nPtr = other._nPtr;
+
+            return *this;
+		}
+
+		/**
+			Distruttore dell'iteratore
+
+			@brief distruttore
+		*/
+		~const_iterator() {}
+
+		/** 
+			ritorna il dato riferito dal const_iterator (dereferenziamento)
+			
+			@brief operatore di deferenziamento
+
+			@return struct element
+		*/
+		reference operator*() const {
+			return *_nPtr;
+		}
+
+		/** 
+			ritorna il dato riferito dal const_iterator 
+			@brief operatore ->
+
+			@return puntatore ad un element
+		*/
+		pointer operator->() const {
+			return _nPtr;
+		}
+		
+		/** 
+			Operatore di post-incremento del const_iterator 
+
+			@brief operatore di post-incremento 
+
+			@return l'iteratore pre incremento
+		*/
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+            ++_nPtr;
+
+            return tmp;
+		}
+
+		/** 
+			Operatore di pre-incremento del const_iterator
+
+			@brief operatore di pre-incremento 
+
+			@return l'iteratore incrementato
+		*/
+		const_iterator& operator++() {
+			++_nPtr;
+            return *this;
+		}
+
+		/** 
+		 	Ridefinizione dell'operatore di uguaglianza
+
+			@brief Operatore di uguaglianza
+
+			@param un altro const_iterator other
+			@return Risultato dell'uguaglianza
+		*/
+		bool operator==(const const_iterator &other) const {
+			return _nPtr == other._nPtr;
+		}
+		
+		/** 
+		 	Ridefinizione dell'operatore di diseguaglianza
+
+			@brief Operatore di uguaglianza
+
+			@param un altro const_iterator other
+			@return Risultato della diseguaglianza
+		*/
+		bool operator!=(const const_iterator &other) const {
+			return _nPtr != other._nPtr;
+		}
+
+		// Solo se serve anche iterator aggiungere le seguenti definizioni
+		
+		friend class iterator;
+
+		/** 
+		 	Ridefinizione dell'operatore di uguaglianza tra const_iterator e iterator 
+
+			@brief Operatore di uguaglianza con iterator
+
+			@param un iteratore costante other
+			@return Risultato dell'uguaglianza
+		*/
+		bool operator==(const iterator &other) const {
+			return _nPtr == other._nPtr;
+		}
+
+		/** 
+		 	Ridefinizione dell'operatore di disuguaglianza tra const_iterator e iterator 
+
+			@brief Operatore di uguaglianza con iterator
+
+			@param un iteratore costante other
+			@return Risultato della disuguaglianza
+		*/
+		bool operator!=(const iterator &other) const {
+			return _nPtr != other._nPtr;
+		}
+
+		/**
+			Costruttore di conversione iterator -> const_iterator
+			@brief conversione da iterator a const_iterator
+
+			@param un altro iterator other
+		*/		
+		const_iterator(const iterator &other) : _nPtr(other._nPtr) {}
+
+		/**
+			Ridefinizione operator = da un iterator a un const_iterator
+
+			@brief operatore di assegnamento
+			@param un altro iterator other
+			@return riferimento al const_iterator
+		*/
+		const_iterator &operator=(const iterator &other) {
+			_nPtr = other._nPtr;
+			return *this;
+		}
+
+		// Solo se serve anche iterator aggiungere le precedenti definizioni
+
+	private:
+		const element* _nPtr;
+
+        friend class SparseMatrix;
+
+        const_iterator(const element* n) : _nPtr(n) {}
+		
+		
+	}; // classe const_iterator
+	
+	/**
+		Ritorna l'iteratore all'inizio della sequenza dati
+	
+		@return iteratore all'inizio della sequenza
+	*/
+	const_iterator begin() const {
+		return const_iterator(_data);
+	}
+	
+	/**
+		Ritorna l'iteratore alla fine della sequenza dati
+	
+		@return iteratore alla fine della sequenza
+	*/
+	const_iterator end() const {
+		return const_iterator(_data + _size);
+	}
+
+    // ------------- RIMOZIONE ----------------
+
+    /**
+		@brief Rimozione di un elemento
+
+        Rimuove l'elemento in posizione (ii,jj), se inserito: da quel momento
+        la cella vale di nuovo il valore di default. La posizione viene
+        trovata con una ricerca binaria e soltanto gli elementi successivi
+        vengono spostati indietro di una posizione. La capacita' dell'array
+        non cambia.
+
+		@param ii indice della riga
+		@param jj indice della colonna
+		@return true se l'elemento era inserito ed e' stato rimosso
+
+		@throw index_out_of_bounds_exception
+		@throw eccezione di allocazione di memoria (runtime), solo se la copia di T puo' fallire
+	*/
+    bool erase(const sm_size ii, const sm_size jj){
+        if(ii >= _nRows || jj >= _nCols)
+            throw index_out_of_bounds_exception();
+
+        const size_type pos = lower_bound(ii, jj);
+        if(pos == _size || _data[pos].i != ii || _data[pos].j != jj)
+            return false;
+
+        remove_at(pos);
+        return true;
+    }
+
+    /**
+		@brief Rimozione dell'elemento riferito da un iteratore
+
+		@param pos iteratore a un elemento della matrice (non end())
+		@return iteratore all'elemento successivo a quello rimosso
+
+		@throw eccezione di allocazione di memoria (runtime), solo se la copia di T puo' fallire
+	*/
+    iterator erase(const_iterator pos){
+        const size_type k = static_cast<size_type>(pos._nPtr - _data);
+        remove_at(k);
+        return iterator(_data + k);
+    }
+
+    /**
+		@brief Rimozione condizionata
+
+        Rimuove in una sola passata tutti gli elementi e per cui pred(e) e'
+        vero; pred riceve l'elemento, quindi puo' scegliere sia in base al
+        valore sia in base alle coordinate. La capacita' dell'array non
+        cambia, vedi shrink_to_fit.
+
+		@param pred predicato unario su const element&
+		@return numero di elementi rimossi
+
+		@throw eccezione di allocazione di memoria (runtime), solo se la copia di T puo' fallire
+	*/
+    template <typename P>
+    size_type erase_if(P pred){
+        return remove_where(pred);
+    }
+
+    /**
+		@brief Rimozione degli elementi uguali al valore di default
+
+        Un add del valore di default viene memorizzato come ogni altro
+        elemento: prune rimuove in una sola passata tutti gli elementi uguali
+        a _D, che non cambiano il valore di nessuna cella.
+        Richiede che T supporti ==.
+
+		@return numero di elementi rimossi
+
+		@throw eccezione di allocazione di memoria (runtime), solo se la copia di T puo' fallire
+	*/
+    size_type prune(){
+        const value_type &d = _D;
+        return remove_where([&d](const element &e){ return e.value == d; });
+    }
+
+    /**
+		@brief Riduzione della memoria
+
+        Rialloca l'array con capacita' pari al numero di elementi e
+        restituisce il vecchio array all'allocatore; una matrice vuota non
+        occupa memoria per gli elementi.
+
+		@throw eccezione di allocazione di memoria (runtime)
+	*/
+    void shrink_to_fit(){
+        if(_capacity == _size)
+            return;
+
+        if(_size == 0){
+            destroy(_data, 0, _capacity);
+            _data = nullptr;
+            _capacity = 0;
+        }
+        else
+            reallocate(_size, _size + 1, nullptr); // nessun elemento da inserire
+    }
+
+    // ------------- VISTA TRASPOSTA ----------------
+
+    /**
+		Vista in sola lettura della trasposta di una matrice, senza copiarne
+		gli elementi. La vista riferisce la matrice originale, che deve
+		sopravviverle; modifiche alla matrice sono visibili nella vista.
+
+		@brief Vista trasposta della matrice
+	*/
+    class transposed_view {
+    public:
+        typedef typename SparseMatrix::sm_size sm_size; ///< tipo delle coordinate
+        typedef typename SparseMatrix::size_type size_type; ///< tipo del numero di elementi
+        typedef typename SparseMatrix::value_type value_type; ///< tipo contenuto nella matrice
+
+        /**
+            @brief Costruttore della vista
+
+            @param m matrice da trasporre
+        */
+        explicit transposed_view(const SparseMatrix &m) : _m(&m) {}
+
+        /**
+            @brief Accesso ai dati in lettura
+
+            @param ii indice della riga della trasposta
+            @param jj indice della colonna della trasposta
+            @return valore della cella (jj,ii) della matrice
+
+            @throw index_out_of_bounds_exception
+        */
+        const value_type& operator()(const sm_size ii, const sm_size jj) const {
+            return (*_m)(jj, ii);
+        }
+
+        /**
+            @brief Prodotto trasposta-vettore
+
+            Calcola y = A^T x senza costruire la trasposta: ogni elemento a_ij
+            della matrice contribuisce (a_ij - _D) * x[i] a y[j], con una sola
+            scansione degli elementi.
+
+            @param x vettore di ingresso, getNumCols() elementi (righe della matrice)
+            @param y vettore di uscita, getNumRows() elementi (colonne della matrice)
+        */
+        void multiply(const value_type *x, value_type *y) const {
+            const SparseMatrix &m = *_m;
+            value_type base = value_type();
+
+            if(!(m._D == value_type())){
+                value_type sum = value_type();
+                for(sm_size r = 0; r < m._nRows; ++r)
+                    sum += x[r];
+                base = m._D * sum;
+            }
+
+            for(sm_size c = 0; c < m._nCols; ++c)
+                y[c] = base;
+            for(size_type k = 0; k < m._size; ++k)
+                y[m._data[k].j] += (m._data[k].value - m._D) * x[m._data[k].i];
+        }
+
+        /**
+            @brief Prodotto trasposta-vettore
+
+            @param x vettore di ingresso, getNumCols() elementi
+            @return vettore y = A^T x di getNumRows() elementi
+
+            @throw dimension_mismatch_exception se x non ha getNumCols() elementi
+        */
+        std::vector<value_type> multiply(const std::vector<value_type> &x) const {
+            if(x.size() != _m -> _nRows)
+                throw dimension_mismatch_exception();
+
+            std::vector<value_type> y(_m -> _nCols);
+            multiply(x.data(), y.data());
+            return y;
+        }
+
+        /**
+            @brief Costruzione della trasposta
+
+            @return la trasposta come matrice, vedi SparseMatrix::transpose()
+        */
+        SparseMatrix materialize() const {
+            return _m -> transpose();
+        }
+
+        /**
+            @brief numero di righe della trasposta
+            @return numero di colonne della matrice
+        */
+        sm_size getNumRows() const {
+            return _m -> _nCols;
+        }
+
+        /**
+            @brief numero di colonne della trasposta
+            @return numero di righe della matrice
+        */
+        sm_size getNumCols() const {
+            return _m -> _nRows;
+        }
+
+        /**
+            @brief numero di elementi inseriti
+            @return numero di elementi inseriti nella matrice
+        */
+        size_type getNumElement() const {
+            return _m -> _size;
+        }
+
+        /**
+            @brief valore di default
+            @return valore di default della matrice
+        */
+        const value_type& getDefaultValue() const {
+            return _m -> _D;
+        }
+
+        /**
+            Iteratore costante della vista. Restituisce gli elementi per valore
+            con le coordinate scambiate, nell'ordine in cui sono salvati nella
+            matrice: per la trasposta e' l'ordine per colonne.
+
+            @brief Iteratore costante della vista trasposta
+        */
+        class const_iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef element value_type;
+            typedef ptrdiff_t difference_type;
+            typedef element reference;
+
+            /**
+                Oggetto restituito da operator->, contiene una copia dell'elemento
+
+                @brief proxy per operator->
+            */
+            struct pointer {
+                element e; ///< elemento puntato
+
+                /**
+                    @brief accesso all'elemento
+                    @return puntatore all'elemento
+                */
+                const element* operator->() const {
+                    return &e;
+                }
+            };
+
+            /**
+                Costruttore dell'iteratore costante
+                @brief Setta il puntatore a nullptr
+            */
+            const_iterator() : _nPtr(nullptr) {}
+
+            /**
+                @brief operatore di deferenziamento
+
+                @return elemento con le coordinate scambiate
+            */
+            reference operator*() const {
+                return element(_nPtr -> j, _nPtr -> i, _nPtr -> value);
+            }
+
+            /**
+                @brief operatore ->
+
+                @return proxy che punta ad un element
+            */
+            pointer operator->() const {
+                pointer p = { **this };
+                return p;
+            }
+
+            /**
+                @brief operatore di post-incremento
+
+                @return l'iteratore pre incremento
+            */
+            const_iterator operator++(int) {
+                const_iterator tmp(*this);
+                ++_nPtr;
+                return tmp;
+            }
+
+            /**
+                @brief operatore di pre-incremento
+
+                @return l'iteratore incrementato
+            */
+            const_iterator& operator++() {
+                ++_nPtr;
+                return *this;
+            }
+
+            /**
+                @brief Operatore di uguaglianza
+
+                @param un altro const_iterator other
+                @return Risultato dell'uguaglianza
+            */
+            bool operator==(const const_iterator &other) const {
+                return _nPtr == other._nPtr;
+            }
+
+            /**
+                @brief Operatore di diseguaglianza
+
+                @param un altro const_iterator other
+                @return Risultato della diseguaglianza
+            */
+            bool operator!=(const const_iterator &other) const {
+                return _nPtr != other._nPtr;
+            }
+
+        private:
+            const element *_nPtr; ///< elemento corrente della matrice
+
+            friend class transposed_view;
+
+            const_iterator(const element *n) : _nPtr(n) {}
+        }; // classe const_iterator
+
+        /**
+            Ritorna l'iteratore all'inizio della sequenza dati
+
+            @return iteratore all'inizio della sequenza
+        */
+        const_iterator begin() const {
+            return const_iterator(_m -> _data);
+        }
+
+        /**
+            Ritorna l'iteratore alla fine della sequenza dati
+
+            @return iteratore alla fine della sequenza
+        */
+        const_iterator end() const {
+            return const_iterator(_m -> _data + _m -> _size);
+        }
+
+    private:
+        const SparseMatrix *_m; ///< matrice trasposta dalla vista
+    }; // classe transposed_view
+
+    /**
+		@brief Vista trasposta
+
+        Ritorna una vista della trasposta che non copia gli elementi, vedi
+        transposed_view. Utile per calcolare A^T x senza costruire A^T.
+
+		@return vista trasposta della matrice
+	*/
+    transposed_view transposed() const {
+        return transposed_view(*this);
+    }
+
+    // ------------- VISTA SU UN BLOCCO ----------------
+
+    /**
+		Vista in sola lettura del blocco A[r0:r1, c0:c1] di una matrice (righe
+		r0..r1-1 e colonne c0..c1-1), senza copiarne gli elementi. Le
+		coordinate della vista partono da 0. La vista riferisce la matrice
+		originale, che deve sopravviverle; modifiche alla matrice sono visibili
+		nella vista. Una vista di una vista riferisce direttamente la matrice.
+
+		@brief Vista su un blocco della matrice
+	*/
+    class submatrix_view {
+    public:
+        typedef typename SparseMatrix::sm_size sm_size; ///< tipo delle coordinate
+        typedef typename SparseMatrix::size_type size_type; ///< tipo del numero di elementi
+        typedef typename SparseMatrix::value_type value_type; ///< tipo contenuto nella matrice
+
+        /**
+            @brief Costruttore della vista
+
+            @param m matrice di cui si vede il blocco
+            @param r0 prima riga del blocco
+            @param r1 riga successiva all'ultima del blocco
+            @param c0 prima colonna del blocco
+            @param c1 colonna successiva all'ultima del blocco
+
+            @throw index_out_of_bounds_exception se il blocco non e' contenuto nella matrice
+        */
+        submatrix_view(const SparseMatrix &m, const sm_size r0, const sm_size r1, const sm_size c0, const sm_size c1)
+            : _m(&m), _r0(r0), _r1(r1), _c0(c0), _c1(c1) {
+            if(r0 > r1 || c0 > c1 || r1 > m._nRows || c1 > m._nCols)
+                throw index_out_of_bounds_exception();
+        }
+
+        /**
+            @brief Accesso ai dati in lettura
+
+            @param ii indice della riga nella vista
+            @param jj indice della colonna nella vista
+            @return valore della cella (r0+ii, c0+jj) della matrice
+
+            @throw index_out_of_bounds_exception
+        */
+        const value_type& operator()(const sm_size ii, const sm_size jj) const {
+            if(ii >= getNumRows() || jj >= getNumCols())
+                throw index_out_of_bounds_exception();
+
+            return (*_m)(_r0 + ii, _c0 + jj);
+        }
+
+        /**
+            @brief Vista su un blocco della vista
+
+            @param r0 prima riga del blocco, nella vista
+            @param r1 riga successiva all'ultima del blocco, nella vista
+            @param c0 prima colonna del blocco, nella vista
+            @param c1 colonna successiva all'ultima del blocco, nella vista
+            @return vista sullo stesso blocco della matrice originale
+
+            @throw index_out_of_bounds_exception se il blocco non e' contenuto nella vista
+        */
+        submatrix_view submatrix(const sm_size r0, const sm_size r1, const sm_size c0, const sm_size c1) const {
+            if(r0 > r1 || c0 > c1 || r1 > getNumRows() || c1 > getNumCols())
+                throw index_out_of_bounds_exception();
+
+            return submatrix_view(*_m, _r0 + r0, _r0 + r1, _c0 + c0, _c0 + c1);
+        }
+
+        /**
+            @brief Copia del blocco
+
+            Gli elementi della vista sono gia' ordinati e senza duplicati:
+            una prima passata li conta, la seconda costruisce l'array con una
+            sola allocazione, senza ricerche.
+
+            @return matrice con gli elementi del blocco e lo stesso valore di default
+
+            @throw eccezione di allocazione di memoria (runtime)
+        */
+        SparseMatrix materialize() const {
+            SparseMatrix sm(getNumRows(), getNumCols(), _m -> _D, _m -> get_allocator());
+            sm.replace(begin(), getNumElement());
+            return sm;
+        }
+
+        /**
+            @brief numero di righe della vista
+            @return numero di righe del blocco
+        */
+        sm_size getNumRows() const {
+            return _r1 - _r0;
+        }
+
+        /**
+            @brief numero di colonne della vista
+            @return numero di colonne del blocco
+        */
+        sm_size getNumCols() const {
+            return _c1 - _c0;
+        }
+
+        /**
+            @brief numero di elementi inseriti nel blocco
+
+            Conta gli elementi iterando sulla vista.
+
+            @return numero di elementi inseriti nel blocco
+        */
+        size_type getNumElement() const {
+            size_type n = 0;
+            for(const_iterator k = begin(), ke = end(); k != ke; ++k)
+                ++n;
+            return n;
+        }
+
+        /**
+            @brief valore di default
+            @return valore di default della matrice
+        */
+        const value_type& getDefaultValue() const {
+            return _m -> _D;
+        }
+
+        /**
+            Iteratore costante della vista. Restituisce per valore, in ordine di
+            riga, gli elementi della matrice che cadono nel blocco, con le
+            coordinate della vista. Quando esce dalle colonne del blocco salta
+            con una ricerca binaria al primo elemento utile della riga
+            successiva, invece di scorrere gli elementi fuori dal blocco.
+            L'iteratore copia i limiti del blocco, quindi resta valido anche
+            dopo la distruzione della vista che lo ha creato (ad esempio una
+            vista temporanea), finche' esiste la matrice.
+
+            @brief Iteratore costante della vista su un blocco
+        */
+        class const_iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef element value_type;
+            typedef ptrdiff_t difference_type;
+            typedef element reference;
+
+            /**
+                Oggetto restituito da operator->, contiene una copia dell'elemento
+
+                @brief proxy per operator->
+            */
+            struct pointer {
+                element e; ///< elemento puntato
+
+                /**
+                    @brief accesso all'elemento
+                    @return puntatore all'elemento
+                */
+                const element* operator->() const {
+                    return &e;
+                }
+            };
+
+            /**
+                Costruttore dell'iteratore costante
+                @brief Setta la matrice a nullptr
+            */
+            const_iterator() : _m(nullptr), _r0(0), _r1(0), _c0(0), _c1(0), _k(0) {}
+
+            /**
+                @brief operatore di deferenziamento
+
+                @return elemento con le coordinate della vista
+            */
+            reference operator*() const {
+                const element &e = _m -> _data[_k];
+                return element(e.i - _r0, e.j - _c0, e.value);
+            }
+
+            /**
+                @brief operatore ->
+
+                @return proxy che punta ad un element
+            */
+            pointer operator->() const {
+                pointer p = { **this };
+                return p;
+            }
+
+            /**
+                @brief operatore di post-incremento
+
+                @return l'iteratore pre incremento
+            */
+            const_iterator operator++(int) {
+                const_iterator tmp(*this);
+                ++*this;
+                return tmp;
+            }
+
+            /**
+                @brief operatore di pre-incremento
+
+                @return l'iteratore incrementato
+            */
+            const_iterator& operator++() {
+                ++_k;
+                seek();
+                return *this;
+            }
+
+            /**
+                @brief Operatore di uguaglianza
+
+                Due iteratori sono uguali se puntano allo stesso elemento della
+                stessa matrice, anche se vengono da copie diverse della vista.
+
+                @param un altro const_iterator other
+                @return Risultato dell'uguaglianza
+            */
+            bool operator==(const const_iterator &other) const {
+                return _m == other._m && _k == other._k;
+            }
+
+            /**
+                @brief Operatore di diseguaglianza
+
+                @param un altro const_iterator other
+                @return Risultato della diseguaglianza
+            */
+            bool operator!=(const const_iterator &other) const {
+                return !(*this == other);
+            }
+
+        private:
+            const SparseMatrix *_m; ///< matrice su cui si itera
+            sm_size _r0, _r1, _c0, _c1; ///< limiti del blocco, copiati dalla vista
+            size_type _k; ///< posizione corrente negli elementi della matrice
+
+            friend class submatrix_view;
+
+            const_iterator(const submatrix_view &v, const size_type k)
+                : _m(v._m), _r0(v._r0), _r1(v._r1), _c0(v._c0), _c1(v._c1), _k(k) {
+                seek();
+            }
+
+            /**
+                Avanza fino al primo elemento del blocco a partire da _k; se non
+                ce ne sono porta l'iteratore alla fine (_k = numero di elementi).
+
+                @brief posiziona l'iteratore su un elemento del blocco
+            */
+            void seek() {
+                const SparseMatrix &m = *_m;
+                while(_k < m._size){
+                    const element &e = m._data[_k];
+                    if(e.i >= _r1)
+                        break;
+                    if(e.j < _c0)
+                        _k = m.lower_bound(e.i, _c0);
+                    else if(e.j >= _c1){
+                        if(e.i + 1 >= _r1)
+                            break;
+                        _k = m.lower_bound(e.i + 1, _c0);
+                    }
+                    else
+                        return;
+                }
+                _k = m._size;
+            }
+        }; // classe const_iterator
+
+        /**
+            Ritorna l'iteratore al primo elemento del blocco
+
+            @return iteratore all'inizio della sequenza
+        */
+        const_iterator begin() const {
+            if(_r0 == _r1 || _c0 == _c1)
+                return end();
+            return const_iterator(*this, _m -> lower_bound(_r0, _c0));
+        }
+
+        /**
+            Ritorna l'iteratore alla fine della sequenza dati
+
+            @return iteratore alla fine della sequenza
+        */
+        const_iterator end() const {
+            return const_iterator(*this, _m -> _size);
+        }
+
+    private:
+        const SparseMatrix *_m; ///< matrice vista
+        sm_size _r0; ///< prima riga del blocco
+        sm_size _r1; ///< riga successiva all'ultima del blocco
+        sm_size _c0; ///< prima colonna del blocco
+        sm_size _c1; ///< colonna successiva all'ultima del blocco
+    }; // classe submatrix_view
+
+    /**
+		@brief Vista su un blocco
+
+        Ritorna una vista del blocco A[r0:r1, c0:c1] che non copia gli
+        elementi, vedi submatrix_view.
+
+		@param r0 prima riga del blocco
+		@param r1 riga successiva all'ultima del blocco
+		@param c0 prima colonna del blocco
+		@param c1 colonna successiva all'ultima del blocco
+		@return vista sul blocco
+
+		@throw index_out_of_bounds_exception se il blocco non e' contenuto nella matrice
+	*/
+    submatrix_view submatrix(const sm_size r0, const sm_size r1, const sm_size c0, const sm_size c1) const {
+        return submatrix_view(*this, r0, r1, c0, c1);
+    }
+};
+
+/**
+	@brief Prodotto tra matrici sparse
+
+	Calcola a * b, vedi SparseMatrix::multiply(const SparseMatrix&, unsigned int).
+
+	@param a matrice di sinistra
+	@param b matrice di destra
+	@return matrice prodotto
+
+	@throw dimension_mismatch_exception
+	@throw default_value_exception
+	@throw eccezione di allocazione di memoria (runtime)
+*/
+template <typename T, typename A, typename I, typename S>
+SparseMatrix<T, A, I, S> operator*(const SparseMatrix<T, A, I, S> &a, const SparseMatrix<T, A, I, S> &b){
+    return a.multiply(b);
+}
+
+/**
+	@brief Operazione elemento per elemento
+
+	Calcola C(i,j) = op(a(i,j), b(i,j)), vedi SparseMatrix::zip_with.
+
+	@param a prima matrice
+	@param b seconda matrice, delle stesse dimensioni
+	@param op funzione binaria da applicare
+	@param dropDefault se true non memorizza i risultati uguali al nuovo valore di default
+	@return matrice risultato
+
+	@throw dimension_mismatch_exception
+	@throw eccezione di allocazione di memoria (runtime)
+*/
+template <typename T, typename A, typename I, typename S, typename F>
+SparseMatrix<T, A, I, S> zip_with(const SparseMatrix<T, A, I, S> &a, const SparseMatrix<T, A, I, S> &b, F op, const bool dropDefault = false){
+    return a.zip_with(b, op, dropDefault);
+}
+
+// ------------- ESPRESSIONI ----------------
+
+/**
+	Foglia di un'espressione: riferisce una matrice sparsa, che deve
+	sopravvivere all'espressione.
+
+	@brief matrice in un'espressione
+*/
+template <typename M>
+class sm_leaf_expr {
+public:
+	typedef M matrix_type; ///< tipo della matrice risultato
+	typedef typename M::value_type value_type; ///< tipo contenuto nella matrice
+	typedef typename M::sm_size sm_size; ///< tipo delle coordinate
+	typedef typename M::element element; ///< elemento della matrice
+	enum { leaves = 1 }; ///< numero di matrici nell'espressione
+
+	explicit sm_leaf_expr(const M &m) : _m(&m) {}
+
+	sm_size getNumRows() const { return _m -> getNumRows(); }
+	sm_size getNumCols() const { return _m -> getNumCols(); }
+	value_type getDefaultValue() const { return _m -> getDefaultValue(); }
+	const M& leftmost() const { return *_m; }
+
+	/**
+		@brief valore nella cella (ii,jj)
+		@throw index_out_of_bounds_exception
+	*/
+	value_type operator()(const sm_size ii, const sm_size jj) const {
+		return (*_m)(ii, jj);
+	}
+
+	/**
+		@brief matrici dell'espressione, da sinistra a destra
+	*/
+	void collect(const M **out) const {
+		out[0] = _m;
+	}
+
+	/**
+		@brief valore nella posizione corrente della fusione
+
+		@param cur elemento della matrice nella posizione corrente, nullptr se assente
+	*/
+	value_type at(const element *const *cur) const {
+		return cur[0] != nullptr ? cur[0] -> value : _m -> getDefaultValue();
+	}
+
+	/**
+		@brief valutazione, vedi SparseMatrix(const E&, bool)
+	*/
+	M eval(const bool dropDefault = false) const {
+		return M(*this, dropDefault);
+	}
+
+private:
+	const M *_m; ///< matrice riferita
+};
+
+/**
+	Nodo binario di un'espressione su matrici sparse, con Op applicata
+	cella per cella. Gli operatori +, - (anche unario) e * per uno scalare
+	costruiscono le espressioni senza calcolare nulla: la valutazione
+	avviene assegnando l'espressione a una SparseMatrix o chiamando eval(),
+	con una sola fusione di tutte le matrici coinvolte. Le espressioni
+	riferiscono le matrici, quindi vanno valutate prima che queste vengano
+	distrutte (attenzione a salvarle con auto).
+
+	@brief operazione binaria tra espressioni
+
+	@param L espressione di sinistra
+	@param R espressione di destra
+	@param Op funzione binaria sui valori
+*/
+template <typename L, typename R, typename Op>
+class sm_binary_expr {
+public:
+	typedef typename L::matrix_type matrix_type; ///< tipo della matrice risultato
+	typedef typename L::value_type value_type; ///< tipo contenuto nella matrice
+	typedef typename L::sm_size sm_size; ///< tipo delle coordinate
+	typedef typename L::element element; ///< elemento della matrice
+	enum { leaves = L::leaves + R::leaves }; ///< numero di matrici nell'espressione
+
+	/**
+		@throw dimension_mismatch_exception se le dimensioni sono diverse
+	*/
+	sm_binary_expr(const L &l, const R &r, Op op = Op()) : _l(l), _r(r), _op(op) {
+		if(l.getNumRows() != r.getNumRows() || l.getNumCols() != r.getNumCols())
+			throw dimension_mismatch_exception();
+	}
+
+	sm_size getNumRows() const { return _l.getNumRows(); }
+	sm_size getNumCols() const { return _l.getNumCols(); }
+	value_type getDefaultValue() const { return _op(_l.getDefaultValue(), _r.getDefaultValue()); }
+	const matrix_type& leftmost() const { return _l.leftmost(); }
+
+	value_type operator()(const sm_size ii, const sm_size jj) const {
+		return _op(_l(ii, jj), _r(ii, jj));
+	}
+
+	void collect(const matrix_type **out) const {
+		_l.collect(out);
+		_r.collect(out + L::leaves);
+	}
+
+	value_type at(const element *const *cur) const {
+		return _op(_l.at(cur), _r.at(cur + L::leaves));
+	}
+
+	matrix_type eval(const bool dropDefault = false) const {
+		return matrix_type(*this, dropDefault);
+	}
+
+private:
+	L _l; ///< operando di sinistra
+	R _r; ///< operando di destra
+	Op _op; ///< operazione
+};
+
+/**
+	@brief prodotto di un'espressione per uno scalare
+*/
+template <typename E>
+class sm_scaled_expr {
+public:
+	typedef typename E::matrix_type matrix_type; ///< tipo della matrice risultato
+	typedef typename E::value_type value_type; ///< tipo contenuto nella matrice
+	typedef typename E::sm_size sm_size; ///< tipo delle coordinate
+	typedef typename E::element element; ///< elemento della matrice
+	enum { leaves = E::leaves }; ///< numero di matrici nell'espressione
+
+	sm_scaled_expr(const value_type &alpha, const E &e) : _alpha(alpha), _e(e) {}
+
+	sm_size getNumRows() const { return _e.getNumRows(); }
+	sm_size getNumCols() const { return _e.getNumCols(); }
+	value_type getDefaultValue() const { return _alpha * _e.getDefaultValue(); }
+	const matrix_type& leftmost() const { return _e.leftmost(); }
+
+	value_type operator()(const sm_size ii, const sm_size jj) const {
+		return _alpha * _e(ii, jj);
+	}
+
+	void collect(const matrix_type **out) const {
+		_e.collect(out);
+	}
+
+	value_type at(const element *const *cur) const {
+		return _alpha * _e.at(cur);
+	}
+
+	matrix_type eval(const bool dropDefault = false) const {
+		return matrix_type(*this, dropDefault);
+	}
+
+private:
+	value_type _alpha; ///< scalare
+	E _e; ///< espressione scalata
+};
+
+/**
+	@brief opposto di un'espressione
+*/
+template <typename E>
+class sm_negated_expr {
+public:
+	typedef typename E::matrix_type matrix_type; ///< tipo della matrice risultato
+	typedef typename E::value_type value_type; ///< tipo contenuto nella matrice
+	typedef typename E::sm_size sm_size; ///< tipo delle coordinate
+	typedef typename E::element element; ///< elemento della matrice
+	enum { leaves = E::leaves }; ///< numero di matrici nell'espressione
+
+	explicit sm_negated_expr(const E &e) : _e(e) {}
+
+	sm_size getNumRows() const { return _e.getNumRows(); }
+	sm_size getNumCols() const { return _e.getNumCols(); }
+	value_type getDefaultValue() const { return -_e.getDefaultValue(); }
+	const matrix_type& leftmost() const { return _e.leftmost(); }
+
+	value_type operator()(const sm_size ii, const sm_size jj) const {
+		return -_e(ii, jj);
+	}
 
-		/**
-			Costruttore dell'iteratore costante
-			@brief Setta il nodo a nullptr
-		*/
-		const_iterator() : _nPtr(nullptr){}
-		
-		/**
-			Copy constructor dell'iteratore costante
+	void collect(const matrix_type **out) const {
+		_e.collect(out);
+	}
 
-			@brief copy constructor 
+	value_type at(const element *const *cur) const {
+		return -_e.at(cur);
+	}
 
-			@param un altro const_iterator other
-		*/	
-		const_iterator(const const_iterator &other) : _nPtr(other._nPtr){}
+	matrix_type eval(const bool dropDefault = false) const {
+		return matrix_type(*this, dropDefault);
+	}
 
-		/**
-			Ridefinizione operator =
+private:
+	E _e; ///< espressione negata
+};
 
-			@brief operatore di assegnamento
-			@param un altro const_iterator other
-			@return riferimento all'iteratore
-		*/
-		const_iterator& operator=(const const_iterator &other) {
-			_nPtr = other._nPtr;
+/**
+	@brief una matrice sparsa e' una foglia
+*/
+template <typename T, typename A, typename I, typename S>
+struct sm_expression_traits<SparseMatrix<T, A, I, S> > {
+	typedef sm_leaf_expr<SparseMatrix<T, A, I, S> > type;
+	static type wrap(const SparseMatrix<T, A, I, S> &m) { return type(m); }
+};
 
-            return *this;
-		}
+/**
+	@brief i nodi sono gia' espressioni
+*/
+template <typename E>
+struct sm_expression_node {
+	typedef E type;
+	static const E& wrap(const E &e) { return e; }
+};
 
-		/**
-			Distruttore dell'iteratore
+template <typename M>
+struct sm_expression_traits<sm_leaf_expr<M> > : sm_expression_node<sm_leaf_expr<M> > {};
 
-			@brief distruttore
-		*/
-		~const_iterator() {}
+template <typename L, typename R, typename Op>
+struct sm_expression_traits<sm_binary_expr<L, R, Op> > : sm_expression_node<sm_binary_expr<L, R, Op> > {};
 
-		/** 
-			ritorna il dato riferito dal const_iterator (dereferenziamento)
-			
-			@brief operatore di deferenziamento
+template <typename E>
+struct sm_expression_traits<sm_scaled_expr<E> > : sm_expression_node<sm_scaled_expr<E> > {};
 
-			@return struct element
-		*/
-		reference operator*() const {
-			return _nPtr -> field;
-		}
+template <typename E>
+struct sm_expression_traits<sm_negated_expr<E> > : sm_expression_node<sm_negated_expr<E> > {};
 
-		/** 
-			ritorna il dato riferito dal const_iterator 
-			@brief operatore ->
+/**
+	@brief tipo del nodo binario tra L e R, definito solo se L e R sono espressioni sulla stessa matrice
+*/
+template <typename L, typename R, template <typename> class Op,
+          typename LE = typename sm_expression_traits<L>::type, typename RE = typename sm_expression_traits<R>::type>
+struct sm_binary_result
+	: std::enable_if<std::is_same<typename LE::matrix_type, typename RE::matrix_type>::value,
+	                 sm_binary_expr<LE, RE, Op<typename LE::value_type> > > {};
 
-			@return puntatore ad un element
-		*/
-		pointer operator->() const {
-			return &(_nPtr -> field);
-		}
-		
-		/** 
-			Operatore di post-incremento del const_iterator 
+/**
+	@brief Somma elemento per elemento
 
-			@brief operatore di post-incremento 
+	Costruisce l'espressione a + b, valutata in modo pigro (vedi
+	sm_binary_expr). Il valore di default del risultato e' la somma dei
+	valori di default.
 
-			@return l'iteratore pre incremento
-		*/
-		const_iterator operator++(int) {
-			const_iterator tmp(*this);
-            _nPtr = _nPtr->next;
+	@param a prima matrice o espressione
+	@param b seconda matrice o espressione, delle stesse dimensioni
+	@return espressione a + b
 
-            return tmp;
-		}
+	@throw dimension_mismatch_exception
+*/
+template <typename L, typename R>
+typename sm_binary_result<L, R, std::plus>::type operator+(const L &a, const R &b){
+	return typename sm_binary_result<L, R, std::plus>::type(sm_expression_traits<L>::wrap(a), sm_expression_traits<R>::wrap(b));
+}
 
-		/** 
-			Operatore di pre-incremento del const_iterator
+/**
+	@brief Differenza elemento per elemento
 
-			@brief operatore di pre-incremento 
+	Costruisce l'espressione a - b, valutata in modo pigro (vedi
+	sm_binary_expr). Il valore di default del risultato e' la differenza
+	dei valori di default.
 
-			@return l'iteratore incrementato
-		*/
-		const_iterator& operator++() {
-			_nPtr = _nPtr -> next;
-            return *this;
-		}
+	@param a prima matrice o espressione
+	@param b seconda matrice o espressione, delle stesse dimensioni
+	@return espressione a - b
 
-		/** 
-		 	Ridefinizione dell'operatore di uguaglianza
+	@throw dimension_mismatch_exception
+*/
+template <typename L, typename R>
+typename sm_binary_result<L, R, std::minus>::type operator-(const L &a, const R &b){
+	return typename sm_binary_result<L, R, std::minus>::type(sm_expression_traits<L>::wrap(a), sm_expression_traits<R>::wrap(b));
+}
 
-			@brief Operatore di uguaglianza
+/**
+	@brief Opposto elemento per elemento, valutato in modo pigro
 
-			@param un altro const_iterator other
-			@return Risultato dell'uguaglianza
-		*/
-		bool operator==(const const_iterator &other) const {
-			return _nPtr == other._nPtr;
-		}
-		
-		/** 
-		 	Ridefinizione dell'operatore di diseguaglianza
+	@param e matrice o espressione
+	@return espressione -e
+*/
+template <typename E>
+sm_negated_expr<typename sm_expression_traits<E>::type> operator-(const E &e){
+	return sm_negated_expr<typename sm_expression_traits<E>::type>(sm_expression_traits<E>::wrap(e));
+}
 
-			@brief Operatore di uguaglianza
+/**
+	@brief Prodotto per uno scalare, valutato in modo pigro
 
-			@param un altro const_iterator other
-			@return Risultato della diseguaglianza
-		*/
-		bool operator!=(const const_iterator &other) const {
-			return _nPtr != other._nPtr;
-		}
+	@param alpha scalare
+	@param e matrice o espressione
+	@return espressione alpha * e
+*/
+template <typename E>
+sm_scaled_expr<typename sm_expression_traits<E>::type>
+operator*(const typename sm_expression_traits<E>::type::value_type &alpha, const E &e){
+	return sm_scaled_expr<typename sm_expression_traits<E>::type>(alpha, sm_expression_traits<E>::wrap(e));
+}
 
-		// Solo se serve anche iterator aggiungere le seguenti definizioni
-		
-		friend class iterator;
+/**
+	@brief Prodotto per uno scalare, valutato in modo pigro
 
-		/** 
-		 	Ridefinizione dell'operatore di uguaglianza tra const_iterator e iterator 
+	@param e matrice o espressione
+	@param alpha scalare
+	@return espressione alpha * e
+*/
+template <typename E>
+sm_scaled_expr<typename sm_expression_traits<E>::type>
+operator*(const E &e, const typename sm_expression_traits<E>::type::value_type &alpha){
+	return sm_scaled_expr<typename sm_expression_traits<E>::type>(alpha, sm_expression_traits<E>::wrap(e));
+}
 
-			@brief Operatore di uguaglianza con iterator
+/**
+	@brief Prodotto elemento per elemento (di Hadamard)
 
-			@param un iteratore costante other
-			@return Risultato dell'uguaglianza
-		*/
-		bool operator==(const iterator &other) const {
-			return _nPtr == other._nPtr;
-		}
+	Il valore di default del risultato e' il prodotto dei valori di default.
 
-		/** 
-		 	Ridefinizione dell'operatore di disuguaglianza tra const_iterator e iterator 
+	@param a prima matrice
+	@param b seconda matrice, delle stesse dimensioni
+	@param dropDefault se true non memorizza i risultati uguali al nuovo valore di default
+	@return matrice con C(i,j) = a(i,j) * b(i,j)
 
-			@brief Operatore di uguaglianza con iterator
+	@throw dimension_mismatch_exception
+	@throw eccezione di allocazione di memoria (runtime)
+*/
+template <typename T, typename A, typename I, typename S>
+SparseMatrix<T, A, I, S> elementwise_multiply(const SparseMatrix<T, A, I, S> &a, const SparseMatrix<T, A, I, S> &b, const bool dropDefault = false){
+    return a.zip_with(b, std::multiplies<T>(), dropDefault);
+}
 
-			@param un iteratore costante other
-			@return Risultato della disuguaglianza
-		*/
-		bool operator!=(const iterator &other) const {
-			return _nPtr != other._nPtr;
-		}
+/**
+	@brief Scambio di due matrici sparse
 
-		/**
-			Costruttore di conversione iterator -> const_iterator
-			@brief conversione da iterator a const_iterator
+	Scambia il contenuto delle due matrici in O(1), vedi SparseMatrix::swap.
 
-			@param un altro iterator other
-		*/		
-		const_iterator(const iterator &other) : _nPtr(other._nPtr) {}
+	@param a prima matrice
+	@param b seconda matrice
+*/
+template <typename T, typename A, typename I, typename S>
+void swap(SparseMatrix<T, A, I, S> &a, SparseMatrix<T, A, I, S> &b) noexcept(noexcept(a.swap(b))){
+    a.swap(b);
+}
 
-		/**
-			Ridefinizione operator = da un iterator a un const_iterator
+/**
+	Politiche di esecuzione di evaluate, sul modello di std::execution che
+	non e' disponibile in C++11. par e par_unseq usano un thread per core;
+	par(n) e par_unseq(n) ne usano n.
+*/
+namespace execution {
 
-			@brief operatore di assegnamento
-			@param un altro iterator other
-			@return riferimento al const_iterator
-		*/
-		const_iterator &operator=(const iterator &other) {
-			_nPtr = other._nPtr;
-			return *this;
-		}
+/**
+	@brief esecuzione sequenziale
+*/
+struct sequenced_policy {};
 
-		// Solo se serve anche iterator aggiungere le precedenti definizioni
+/**
+	Gli elementi inseriti vengono divisi in blocchi, uno per thread.
 
-	private:
-		const node* _nPtr;
+	@brief esecuzione parallela
+*/
+struct parallel_policy {
+	unsigned int threads; ///< numero di thread, 0 per un thread per core
 
-        friend class SparseMatrix;
+	/**
+		@brief Costruttore
+		@param t numero di thread, 0 per un thread per core
+	*/
+	explicit parallel_policy(const unsigned int t = 0) : threads(t) {}
 
-        const_iterator(const node* n) : _nPtr(n) {}
-		
-		
-	}; // classe const_iterator
-	
 	/**
-		Ritorna l'iteratore all'inizio della sequenza dati
-	
-		@return iteratore all'inizio della sequenza
+		@brief stessa politica con un numero di thread dato
+		@param t numero di thread
+		@return politica con t thread
 	*/
-	const_iterator begin() const {
-		return const_iterator(_head);
+	parallel_policy operator()(const unsigned int t) const {
+		return parallel_policy(t);
 	}
-	
+};
+
+/**
+	Come parallel_policy, ma le chiamate al predicato possono essere
+	riordinate: il predicato non deve avere effetti collaterali. Per T
+	aritmetico il conteggio avviene senza salti e puo' essere vettorizzato.
+
+	@brief esecuzione parallela e non sequenziale
+*/
+struct parallel_unsequenced_policy {
+	unsigned int threads; ///< numero di thread, 0 per un thread per core
+
 	/**
-		Ritorna l'iteratore alla fine della sequenza dati
-	
-		@return iteratore alla fine della sequenza
+		@brief Costruttore
+		@param t numero di thread, 0 per un thread per core
 	*/
-	const_iterator end() const {
-		return const_iterator(nullptr);
+	explicit parallel_unsequenced_policy(const unsigned int t = 0) : threads(t) {}
+
+	/**
+		@brief stessa politica con un numero di thread dato
+		@param t numero di thread
+		@return politica con t thread
+	*/
+	parallel_unsequenced_policy operator()(const unsigned int t) const {
+		return parallel_unsequenced_policy(t);
 	}
 };
 
+const sequenced_policy seq = sequenced_policy(); ///< esecuzione sequenziale
+const parallel_policy par = parallel_policy(); ///< esecuzione parallela
+const parallel_unsequenced_policy par_unseq = parallel_unsequenced_policy(); ///< esecuzione parallela non sequenziale
+
+} // namespace execution
+
 /**
-    @brief numero di elementi che soddisfano il predicato
+	Funzione helper che conta gli elementi in [first, last) il cui valore
+	soddisfa il predicato, un elemento alla volta.
+
+	@brief conteggio sequenziale
+*/
+template <typename E, typename P>
+unsigned long long evaluate_count(const E *first, const E *last, P &pred, std::false_type){
+	unsigned long long counter = 0;
+	for(; first != last; ++first)
+		if(pred(first -> value))
+			++counter;
+	return counter;
+}
+
+/**
+	Funzione helper che conta gli elementi in [first, last) il cui valore
+	soddisfa il predicato senza salti, su quattro contatori indipendenti:
+	il ciclo non ha dipendenze tra iterazioni e il compilatore puo'
+	vettorizzarlo quando il predicato e' un semplice confronto.
 
+	@brief conteggio vettorizzabile
+*/
+template <typename E, typename P>
+unsigned long long evaluate_count(const E *first, const E *last, P &pred, std::true_type){
+	unsigned long long c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+	for(; last - first >= 4; first += 4){
+		c0 += static_cast<bool>(pred(first[0].value));
+		c1 += static_cast<bool>(pred(first[1].value));
+		c2 += static_cast<bool>(pred(first[2].value));
+		c3 += static_cast<bool>(pred(first[3].value));
+	}
+	for(; first != last; ++first)
+		c0 += static_cast<bool>(pred(first -> value));
+	return c0 + c1 + c2 + c3;
+}
+
+/**
+	Funzione helper che conta i valori di default che soddisfano il predicato.
+	Il numero di celle e' calcolato a 64 bit: con coordinate a 64 bit il
+	prodotto righe * colonne puo' non essere rappresentabile, e in quel caso
+	viene lanciata un'eccezione invece di restituire un conteggio troncato.
+
+	@brief conteggio dei valori di default
+
+	@throw std::overflow_error se il numero di valori di default non sta in 64 bit
+*/
+template <typename M, typename A, typename I, typename S, typename P>
+unsigned long long evaluate_default(const SparseMatrix<M, A, I, S> &sm, P &pred){
+	if(!pred(sm.getDefaultValue()))
+		return 0;
+
+	const unsigned long long rows = sm.getNumRows();
+	const unsigned long long cols = sm.getNumCols();
+	if(rows != 0 && cols > std::numeric_limits<unsigned long long>::max() / rows)
+		throw std::overflow_error("Default cell count exceeds 64 bits");
+
+	return rows * cols - sm.getNumElement();
+}
+
+/**
+	Funzione helper che divide gli elementi inseriti in blocchi, uno per
+	thread, e somma i conteggi dei blocchi. Ogni thread usa una propria copia
+	del predicato.
+
+	@brief conteggio parallelo
+*/
+template <typename M, typename A, typename I, typename S, typename P, typename Unseq>
+unsigned long long evaluate_parallel(const SparseMatrix<M, A, I, S> &sm, P pred, unsigned int threads, Unseq unseq){
+	typedef typename SparseMatrix<M, A, I, S>::element element;
+
+	const unsigned long long size = sm.getNumElement();
+	if(threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if(threads > size)
+		threads = static_cast<unsigned int>(size);
+	if(threads == 0)
+		threads = 1;
+
+	const element *data = size ? &*sm.begin() : nullptr;
+	std::vector<unsigned long long> counts(threads, 0);
+	run_parallel(threads, [&](const unsigned int t){
+		P local(pred);
+		counts[t] = evaluate_count(data + size * t / threads, data + size * (t + 1) / threads, local, unseq);
+	});
+
+	unsigned long long counter = evaluate_default(sm, pred);
+	for(unsigned int t = 0; t < threads; ++t)
+		counter += counts[t];
+	return counter;
+}
+
+/**
+	@brief numero di elementi che soddisfano il predicato
 
 	Ritorna il numero di elementi, compresi quelli di default, della matrice
-    che soddisfano un predicato.
+	che soddisfano un predicato, scandendo gli elementi in sequenza.
+	Il conteggio e' a 64 bit.
 
+	@param policy execution::seq
 	@param sm matrice sparsa su cui verificare il predicato
 	@param pred predicato da soddisfare
 
 	@return numero di elementi che soddisfano il predicato
+
+	@throw std::overflow_error se i valori di default sono piu' di 2^64 - 1
 */
-template <typename M, typename P>
-unsigned int  evaluate(const SparseMatrix<M> &sm, P pred){
-	typename SparseMatrix<M> :: const_iterator i, ie;
+template <typename M, typename A, typename I, typename S, typename P>
+unsigned long long evaluate(const execution::sequenced_policy &, const SparseMatrix<M, A, I, S> &sm, P pred){
+	typename SparseMatrix<M, A, I, S> :: const_iterator i, ie;
 
 	i = sm.begin();
 	ie = sm.end();
 
-    unsigned int counter = 0;
-    
-    // controllo se soddisfa il valore di default
-    if(pred(sm.getDefaultValue())){
-        // conto quanti valori di default ci sono nella matrice
-        unsigned int numElementMax = sm.getNumRows() * sm.getNumCols();
-        counter = numElementMax - sm.getNumElement();
-    }
+	unsigned long long counter = evaluate_default(sm, pred);
 	while(i != ie){
-       
-        // se il predicato rispetta il valore aumento il contatore
+		// se il predicato rispetta il valore aumento il contatore
 		if(pred((*i).value)){
 			counter ++;
 		}
 		++i;
 	}
 
-    return counter;
+	return counter;
+}
+
+/**
+	@brief numero di elementi che soddisfano il predicato, in parallelo
+
+	Come evaluate(execution::seq, sm, pred), ma gli elementi inseriti vengono
+	divisi tra policy.threads thread (uno per core se 0).
+
+	@param policy execution::par o execution::par(n)
+	@param sm matrice sparsa su cui verificare il predicato
+	@param pred predicato da soddisfare
+
+	@return numero di elementi che soddisfano il predicato
+
+	@throw std::system_error se non e' possibile creare un thread
+	@throw std::overflow_error se i valori di default sono piu' di 2^64 - 1
+*/
+template <typename M, typename A, typename I, typename S, typename P>
+unsigned long long evaluate(const execution::parallel_policy &policy, const SparseMatrix<M, A, I, S> &sm, P pred){
+	return evaluate_parallel(sm, pred, policy.threads, std::false_type());
+}
+
+/**
+	@brief numero di elementi che soddisfano il predicato, in parallelo e vettorizzato
+
+	Come evaluate(execution::par, sm, pred); per T aritmetico ogni thread
+	conta senza salti, in un ciclo vettorizzabile. Il predicato non deve
+	avere effetti collaterali.
+
+	@param policy execution::par_unseq o execution::par_unseq(n)
+	@param sm matrice sparsa su cui verificare il predicato
+	@param pred predicato da soddisfare
+
+	@return numero di elementi che soddisfano il predicato
+
+	@throw std::system_error se non e' possibile creare un thread
+	@throw std::overflow_error se i valori di default sono piu' di 2^64 - 1
+*/
+template <typename M, typename A, typename I, typename S, typename P>
+unsigned long long evaluate(const execution::parallel_unsequenced_policy &policy, const SparseMatrix<M, A, I, S> &sm, P pred){
+	return evaluate_parallel(sm, pred, policy.threads, std::integral_constant<bool, std::is_arithmetic<M>::value>());
+}
+
+/**
+    @brief numero di elementi che soddisfano il predicato
+
+
+	Ritorna il numero di elementi, compresi quelli di default, della matrice
+    che soddisfano un predicato. Equivale a evaluate(execution::seq, sm, pred).
+
+	@param sm matrice sparsa su cui verificare il predicato
+	@param pred predicato da soddisfare
+
+	@return numero di elementi che soddisfano il predicato
+
+	@throw std::overflow_error se i valori di default sono piu' di 2^64 - 1
+*/
+template <typename M, typename A, typename I, typename S, typename P>
+unsigned long long evaluate(const SparseMatrix<M, A, I, S> &sm, P pred){
+	return evaluate(execution::seq, sm, pred);
 }
 
+#if __cplusplus >= 201703L
+/**
+	Matrice sparsa che prende la memoria da un std::pmr::memory_resource,
+	ad esempio un'arena std::pmr::monotonic_buffer_resource.
+
+	@brief Matrice sparsa con allocatore polimorfico
+
+	@param T tipo del dato
+	@param I tipo delle coordinate
+	@param S politica di strumentazione
+*/
+template <typename T, typename I = unsigned int, typename S = no_instrumentation>
+using PmrSparseMatrix = SparseMatrix<T, std::pmr::polymorphic_allocator<T>, I, S>;
+#endif
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,315 @@
+#ifndef SpmvKernels_H
+#define SpmvKernels_H
+
+#include <cstddef>  // size_t
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPMV_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/**
+	@file SpmvKernels.h
+	@brief Kernel del prodotto matrice-vettore (somma dei prodotti di una riga)
+*/
+
+
+/**
+	Calcola la somma dei prodotti di una riga, sum_k (v[k] - shift) * x[j[k]],
+	dove gli indici j e i valori v sono letti con un passo (in byte) che
+	permette di usare sia array separati (CSR) sia array di strutture
+	(SparseMatrix).
+
+	@brief somma scalare dei prodotti di una riga
+
+	@param j puntatore al primo indice di colonna, di tipo intero qualunque
+	@param jStride distanza in byte tra due indici consecutivi
+	@param v puntatore al primo valore
+	@param vStride distanza in byte tra due valori consecutivi
+	@param n numero di elementi della riga
+	@param x vettore di ingresso
+	@param shift valore da sottrarre a ogni v (il valore di default)
+	@param useShift false se shift e' T() e la sottrazione va saltata
+	@return somma dei prodotti
+*/
+template <typename T, typename I>
+T spmv_scalar_dot(const I *j, const size_t jStride, const T *v, const size_t vStride,
+                  const size_t n, const T *x, const T &shift, const bool useShift){
+	const char *jp = reinterpret_cast<const char*>(j);
+	const char *vp = reinterpret_cast<const char*>(v);
+	T acc = T();
+
+	if(useShift)
+		for(size_t k = 0; k < n; ++k, jp += jStride, vp += vStride)
+			acc += (*reinterpret_cast<const T*>(vp) - shift) * x[*reinterpret_cast<const I*>(jp)];
+	else
+		for(size_t k = 0; k < n; ++k, jp += jStride, vp += vStride)
+			acc += *reinterpret_cast<const T*>(vp) * x[*reinterpret_cast<const I*>(jp)];
+
+	return acc;
+}
+
+/**
+	Kernel del prodotto matrice-vettore usato da SparseMatrix e CsrMatrix.
+	Per float e double esistono specializzazioni vettorizzate, per tutti gli
+	altri tipi (anche quelli definiti dall'utente) viene usato il ciclo scalare.
+	Gli indici devono essere minori di 2^31: con piu' colonne il chiamante
+	usa direttamente spmv_scalar_dot.
+
+	@brief kernel del prodotto matrice-vettore
+
+	@param T tipo del dato
+*/
+template <typename T>
+struct spmv_kernel {
+	/**
+		@brief somma dei prodotti di una riga, vedi spmv_scalar_dot
+	*/
+	static T dot(const unsigned int *j, const size_t jStride, const T *v, const size_t vStride,
+	             const size_t n, const T *x, const T &shift, const bool useShift){
+		return spmv_scalar_dot(j, jStride, v, vStride, n, x, shift, useShift);
+	}
+};
+
+#ifdef SPMV_X86_KERNELS
+
+/**
+	Implementazioni vettorizzate del kernel per float e double (SSE2, AVX2
+	e AVX-512). Ogni funzione e' compilata per il proprio set di istruzioni
+	con l'attributo target, quindi non servono flag di compilazione:
+	la versione da usare viene scelta a runtime con CPUID.
+	Gli indici vengono letti come interi con segno a 32 bit, quindi il
+	chiamante deve usarle solo se il numero di colonne non supera 2^31 - 1.
+
+	@brief kernel vettorizzati per x86
+*/
+struct spmv_simd {
+
+	/// tipo dei kernel per T
+	template <typename T>
+	struct kernel {
+		typedef T (*type)(const unsigned int*, size_t, const T*, size_t, size_t, const T*, T);
+	};
+
+	// ------------- scalare ----------------
+
+	template <typename T>
+	static T scalar(const unsigned int *j, size_t jStride, const T *v, size_t vStride, size_t n, const T *x, T shift){
+		return spmv_scalar_dot<T>(j, jStride, v, vStride, n, x, shift, true);
+	}
+
+	// ------------- SSE2 ----------------
+	// non c'e' gather: carico gli elementi singolarmente e vettorizzo le operazioni
+
+	__attribute__((target("sse2")))
+	static double sse2(const unsigned int *j, size_t jStride, const double *v, size_t vStride, size_t n, const double *x, double shift){
+		const char *jp = reinterpret_cast<const char*>(j);
+		const char *vp = reinterpret_cast<const char*>(v);
+		const __m128d s = _mm_set1_pd(shift);
+		__m128d acc = _mm_setzero_pd();
+		size_t k = 0;
+
+		for(; k + 2 <= n; k += 2, jp += 2 * jStride, vp += 2 * vStride){
+			__m128d xv = _mm_set_pd(x[*reinterpret_cast<const unsigned int*>(jp + jStride)],
+			                        x[*reinterpret_cast<const unsigned int*>(jp)]);
+			__m128d vv = _mm_set_pd(*reinterpret_cast<const double*>(vp + vStride),
+			                        *reinterpret_cast<const double*>(vp));
+			acc = _mm_add_pd(acc, _mm_mul_pd(_mm_sub_pd(vv, s), xv));
+		}
+
+		double r = _mm_cvtsd_f64(_mm_add_pd(acc, _mm_unpackhi_pd(acc, acc)));
+		return r + spmv_scalar_dot<double>(reinterpret_cast<const unsigned int*>(jp), jStride,
+		                                    reinterpret_cast<const double*>(vp), vStride, n - k, x, shift, true);
+	}
+
+	__attribute__((target("sse2")))
+	static float sse2(const unsigned int *j, size_t jStride, const float *v, size_t vStride, size_t n, const float *x, float shift){
+		const char *jp = reinterpret_cast<const char*>(j);
+		const char *vp = reinterpret_cast<const char*>(v);
+		const __m128 s = _mm_set1_ps(shift);
+		__m128 acc = _mm_setzero_ps();
+		size_t k = 0;
+
+		for(; k + 4 <= n; k += 4, jp += 4 * jStride, vp += 4 * vStride){
+			__m128 xv = _mm_set_ps(x[*reinterpret_cast<const unsigned int*>(jp + 3 * jStride)],
+			                       x[*reinterpret_cast<const unsigned int*>(jp + 2 * jStride)],
+			                       x[*reinterpret_cast<const unsigned int*>(jp + jStride)],
+			                       x[*reinterpret_cast<const unsigned int*>(jp)]);
+			__m128 vv = _mm_set_ps(*reinterpret_cast<const float*>(vp + 3 * vStride),
+			                       *reinterpret_cast<const float*>(vp + 2 * vStride),
+			                       *reinterpret_cast<const float*>(vp + vStride),
+			                       *reinterpret_cast<const float*>(vp));
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_sub_ps(vv, s), xv));
+		}
+
+		acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+		acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+		return _mm_cvtss_f32(acc) + spmv_scalar_dot<float>(reinterpret_cast<const unsigned int*>(jp), jStride,
+		                                                   reinterpret_cast<const float*>(vp), vStride, n - k, x, shift, true);
+	}
+
+	// ------------- AVX2 ----------------
+	// gli indici e i valori non contigui vengono letti con gather a passo costante
+
+	__attribute__((target("avx2,fma")))
+	static double avx2(const unsigned int *j, size_t jStride, const double *v, size_t vStride, size_t n, const double *x, double shift){
+		const char *jp = reinterpret_cast<const char*>(j);
+		const char *vp = reinterpret_cast<const char*>(v);
+		const int js = static_cast<int>(jStride), vs = static_cast<int>(vStride);
+		const __m128i jOff = _mm_setr_epi32(0, js, 2 * js, 3 * js);
+		const __m128i vOff = _mm_setr_epi32(0, vs, 2 * vs, 3 * vs);
+		const __m256d s = _mm256_set1_pd(shift);
+		__m256d acc = _mm256_setzero_pd();
+		size_t k = 0;
+
+		for(; k + 4 <= n; k += 4, jp += 4 * jStride, vp += 4 * vStride){
+			__m128i idx = jStride == sizeof(int) ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(jp))
+			                                     : _mm_i32gather_epi32(reinterpret_cast<const int*>(jp), jOff, 1);
+			__m256d vv = vStride == sizeof(double) ? _mm256_loadu_pd(reinterpret_cast<const double*>(vp))
+			                                       : _mm256_i32gather_pd(reinterpret_cast<const double*>(vp), vOff, 1);
+			__m256d xv = _mm256_i32gather_pd(x, idx, 8);
+			acc = _mm256_fmadd_pd(_mm256_sub_pd(vv, s), xv, acc);
+		}
+
+		__m128d h = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+		double r = _mm_cvtsd_f64(_mm_add_pd(h, _mm_unpackhi_pd(h, h)));
+		return r + spmv_scalar_dot<double>(reinterpret_cast<const unsigned int*>(jp), jStride,
+		                                    reinterpret_cast<const double*>(vp), vStride, n - k, x, shift, true);
+	}
+
+	__attribute__((target("avx2,fma")))
+	static float avx2(const unsigned int *j, size_t jStride, const float *v, size_t vStride, size_t n, const float *x, float shift){
+		const char *jp = reinterpret_cast<const char*>(j);
+		const char *vp = reinterpret_cast<const char*>(v);
+		const int js = static_cast<int>(jStride), vs = static_cast<int>(vStride);
+		const __m256i jOff = _mm256_setr_epi32(0, js, 2 * js, 3 * js, 4 * js, 5 * js, 6 * js, 7 * js);
+		const __m256i vOff = _mm256_setr_epi32(0, vs, 2 * vs, 3 * vs, 4 * vs, 5 * vs, 6 * vs, 7 * vs);
+		const __m256 s = _mm256_set1_ps(shift);
+		__m256 acc = _mm256_setzero_ps();
+		size_t k = 0;
+
+		for(; k + 8 <= n; k += 8, jp += 8 * jStride, vp += 8 * vStride){
+			__m256i idx = jStride == sizeof(int) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(jp))
+			                                     : _mm256_i32gather_epi32(reinterpret_cast<const int*>(jp), jOff, 1);
+			__m256 vv = vStride == sizeof(float) ? _mm256_loadu_ps(reinterpret_cast<const float*>(vp))
+			                                     : _mm256_i32gather_ps(reinterpret_cast<const float*>(vp), vOff, 1);
+			__m256 xv = _mm256_i32gather_ps(x, idx, 4);
+			acc = _mm256_fmadd_ps(_mm256_sub_ps(vv, s), xv, acc);
+		}
+
+		__m128 h = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+		h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+		h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+		return _mm_cvtss_f32(h) + spmv_scalar_dot<float>(reinterpret_cast<const unsigned int*>(jp), jStride,
+		                                                 reinterpret_cast<const float*>(vp), vStride, n - k, x, shift, true);
+	}
+
+	// ------------- AVX-512 ----------------
+
+	__attribute__((target("avx512f,avx2")))
+	static double avx512(const unsigned int *j, size_t jStride, const double *v, size_t vStride, size_t n, const double *x, double shift){
+		const char *jp = reinterpret_cast<const char*>(j);
+		const char *vp = reinterpret_cast<const char*>(v);
+		const int js = static_cast<int>(jStride), vs = static_cast<int>(vStride);
+		const __m256i jOff = _mm256_setr_epi32(0, js, 2 * js, 3 * js, 4 * js, 5 * js, 6 * js, 7 * js);
+		const __m256i vOff = _mm256_setr_epi32(0, vs, 2 * vs, 3 * vs, 4 * vs, 5 * vs, 6 * vs, 7 * vs);
+		const __m512d s = _mm512_set1_pd(shift);
+		__m512d acc = _mm512_setzero_pd();
+		size_t k = 0;
+
+		for(; k + 8 <= n; k += 8, jp += 8 * jStride, vp += 8 * vStride){
+			__m256i idx = jStride == sizeof(int) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(jp))
+			                                     : _mm256_i32gather_epi32(reinterpret_cast<const int*>(jp), jOff, 1);
+			__m512d vv = vStride == sizeof(double) ? _mm512_loadu_pd(vp)
+			                                       : _mm512_i32gather_pd(vOff, vp, 1);
+			__m512d xv = _mm512_i32gather_pd(idx, x, 8);
+			acc = _mm512_fmadd_pd(_mm512_sub_pd(vv, s), xv, acc);
+		}
+
+		return _mm512_reduce_add_pd(acc) + spmv_scalar_dot<double>(reinterpret_cast<const unsigned int*>(jp), jStride,
+		                                                            reinterpret_cast<const double*>(vp), vStride, n - k, x, shift, true);
+	}
+
+	__attribute__((target("avx512f")))
+	static float avx512(const unsigned int *j, size_t jStride, const float *v, size_t vStride, size_t n, const float *x, float shift){
+		const char *jp = reinterpret_cast<const char*>(j);
+		const char *vp = reinterpret_cast<const char*>(v);
+		const int js = static_cast<int>(jStride), vs = static_cast<int>(vStride);
+		const __m512i jOff = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(js));
+		const __m512i vOff = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(vs));
+		const __m512 s = _mm512_set1_ps(shift);
+		__m512 acc = _mm512_setzero_ps();
+		size_t k = 0;
+
+		for(; k + 16 <= n; k += 16, jp += 16 * jStride, vp += 16 * vStride){
+			__m512i idx = jStride == sizeof(int) ? _mm512_loadu_si512(jp) : _mm512_i32gather_epi32(jOff, jp, 1);
+			__m512 vv = vStride == sizeof(float) ? _mm512_loadu_ps(vp) : _mm512_i32gather_ps(vOff, vp, 1);
+			__m512 xv = _mm512_i32gather_ps(idx, x, 4);
+			acc = _mm512_fmadd_ps(_mm512_sub_ps(vv, s), xv, acc);
+		}
+
+		return _mm512_reduce_add_ps(acc) + spmv_scalar_dot<float>(reinterpret_cast<const unsigned int*>(jp), jStride,
+		                                                          reinterpret_cast<const float*>(vp), vStride, n - k, x, shift, true);
+	}
+
+	/**
+		Sceglie con CPUID il kernel migliore supportato dal processore.
+
+		@brief selezione del kernel a runtime
+
+		@return puntatore al kernel
+	*/
+	template <typename T>
+	static typename kernel<T>::type select(){
+		__builtin_cpu_init();
+		// il kernel AVX-512 per double legge gli indici con il gather di AVX2
+		if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2"))
+			return &avx512;
+		if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return &avx2;
+		if(__builtin_cpu_supports("sse2"))
+			return &sse2;
+		return &scalar<T>;
+	}
+
+	/**
+		@brief kernel scelto per T, selezionato una sola volta
+	*/
+	template <typename T>
+	static typename kernel<T>::type get(){
+		static const typename kernel<T>::type k = select<T>();
+		return k;
+	}
+};
+
+/**
+	Specializzazione del kernel per double, vettorizzata con il set di
+	istruzioni migliore disponibile.
+
+	@brief kernel del prodotto matrice-vettore per double
+*/
+template <>
+struct spmv_kernel<double> {
+	static double dot(const unsigned int *j, const size_t jStride, const double *v, const size_t vStride,
+	                  const size_t n, const double *x, const double &shift, const bool useShift){
+		return spmv_simd::get<double>()(j, jStride, v, vStride, n, x, useShift ? shift : 0.0);
+	}
+};
+
+/**
+	Specializzazione del kernel per float, vettorizzata con il set di
+	istruzioni migliore disponibile.
+
+	@brief kernel del prodotto matrice-vettore per float
+*/
+template <>
+struct spmv_kernel<float> {
+	static float dot(const unsigned int *j, const size_t jStride, const float *v, const size_t vStride,
+	                 const size_t n, const float *x, const float &shift, const bool useShift){
+		return spmv_simd::get<float>()(j, jStride, v, vStride, n, x, useShift ? shift : 0.0f);
+	}
+};
+
+#endif
+
+#endif
@@ -0,0 +1,265 @@
+/**
+	@file bench.cpp
+	@brief Benchmark della classe SparseMatrix
+
+	Misura le operazioni principali della matrice sparsa al variare del
+	numero di righe e del numero medio di elementi per riga, e scrive i
+	risultati su stdout in formato JSON (ns per operazione e byte occupati
+	per elemento inserito). Va compilato con -O3 -DNDEBUG, vedi il target
+	bench del Makefile.
+*/
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <string>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include "SparseMatrix.h"
+
+// byte attualmente allocati da tracking_allocator
+static std::size_t liveBytes = 0;
+
+/**
+	Allocatore che tiene traccia dei byte allocati, usato per misurare la
+	memoria occupata per elemento.
+
+	@brief allocatore che conta i byte
+*/
+template <typename T>
+struct tracking_allocator {
+	typedef T value_type;
+
+	tracking_allocator() {}
+	template <typename U>
+	tracking_allocator(const tracking_allocator<U> &) {}
+
+	T *allocate(std::size_t n){
+		liveBytes += n * sizeof(T);
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T *p, std::size_t n){
+		liveBytes -= n * sizeof(T);
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	bool operator==(const tracking_allocator &) const { return true; }
+	bool operator!=(const tracking_allocator &) const { return false; }
+};
+
+typedef SparseMatrix<double, tracking_allocator<double> > matrix;
+
+// coordinata di un elemento
+struct coord {
+	unsigned int i, j;
+};
+
+// predicato usato per evaluate
+struct greater_than_half {
+	bool operator()(double v) const {
+		return v > 0.5;
+	}
+};
+
+// evita che il compilatore elimini il calcolo misurato
+static volatile double sink = 0;
+
+/**
+	@brief tempo migliore su tre ripetizioni di f, in ns per operazione
+
+	@param f funzione da misurare
+	@param ops numero di operazioni eseguite da una chiamata di f
+	@return ns per operazione
+*/
+template <typename F>
+double time_ns(F f, const std::size_t ops){
+	double best = 0;
+	for(int rep = 0; rep < 3; ++rep){
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		f();
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+		if(rep == 0 || ns < best)
+			best = ns;
+	}
+	return ops == 0 ? 0 : best / ops;
+}
+
+/**
+	@brief stampa un risultato come oggetto JSON
+*/
+void report(bool &first, const std::string &op, unsigned int rows, unsigned int perRow, std::size_t nnz,
+            double nsPerOp, double bytesPerNnz){
+	std::cout << (first ? "\n" : ",\n") << "    {\"op\": \"" << op << "\", \"rows\": " << rows
+	          << ", \"cols\": " << rows << ", \"nnz_per_row\": " << perRow << ", \"nnz\": " << nnz
+	          << ", \"ns_per_op\": " << nsPerOp << ", \"bytes_per_nnz\": " << bytesPerNnz << "}";
+	first = false;
+}
+
+/**
+	@brief inserisce tutti gli elementi nell'ordine dato
+*/
+void build(matrix &m, const std::vector<coord> &c, const std::vector<double> &v){
+	for(std::size_t k = 0; k < c.size(); ++k)
+		m.add(c[k].i, c[k].j, v[k]);
+}
+
+int main(){
+	// oltre questa dimensione gli inserimenti non ordinati (quadratici) non vengono misurati
+	const std::size_t maxUnordered = 50000;
+	// oltre questa dimensione gli inserimenti a blocchi (O(nnz) per blocco) non vengono misurati
+	const std::size_t maxBatched = 1000000;
+	const std::size_t batchSize = 10000;
+	const std::size_t lookups = 1000000;
+	const unsigned int sizes[] = { 1000, 10000, 100000 };
+	const unsigned int densities[] = { 4, 32 };
+
+	std::mt19937_64 gen(42);
+	bool first = true;
+
+	std::cout << "{\n  \"benchmark\": \"SparseMatrix\",\n  \"results\": [";
+
+	for(unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s){
+		for(unsigned int d = 0; d < sizeof(densities) / sizeof(densities[0]); ++d){
+			const unsigned int n = sizes[s];
+			const unsigned int perRow = densities[d];
+			const unsigned int stride = n / perRow;
+
+			// perRow colonne distinte per riga, a distanza stride tra loro
+			std::vector<coord> sorted;
+			sorted.reserve(static_cast<std::size_t>(n) * perRow);
+			for(unsigned int i = 0; i < n; ++i)
+				for(unsigned int t = 0; t < perRow; ++t){
+					coord c = { i, (i * 131u + t * stride) % n };
+					sorted.push_back(c);
+				}
+			std::sort(sorted.begin(), sorted.end(), [](const coord &a, const coord &b){
+				return a.i < b.i || (a.i == b.i && a.j < b.j);
+			});
+
+			const std::size_t nnz = sorted.size();
+			std::uniform_real_distribution<double> value(0.0, 1.0);
+			std::vector<double> vals(nnz);
+			for(std::size_t k = 0; k < nnz; ++k)
+				vals[k] = value(gen);
+
+			// ------------- inserimenti ----------------
+			double ns = time_ns([&](){
+				matrix m(n, n, 0.0);
+				build(m, sorted, vals);
+			}, nnz);
+
+			matrix m(n, n, 0.0);
+			std::size_t before = liveBytes;
+			build(m, sorted, vals);
+			const double bytes = static_cast<double>(liveBytes - before) / nnz;
+			report(first, "add_sequential", n, perRow, nnz, ns, bytes);
+
+			if(nnz <= maxUnordered){
+				std::vector<coord> reversed(sorted.rbegin(), sorted.rend());
+				ns = time_ns([&](){
+					matrix r(n, n, 0.0);
+					build(r, reversed, vals);
+				}, nnz);
+				report(first, "add_reverse", n, perRow, nnz, ns, bytes);
+
+				std::vector<coord> shuffled(sorted);
+				std::shuffle(shuffled.begin(), shuffled.end(), gen);
+				ns = time_ns([&](){
+					matrix r(n, n, 0.0);
+					build(r, shuffled, vals);
+				}, nnz);
+				report(first, "add_random", n, perRow, nnz, ns, bytes);
+			}
+
+			if(nnz <= maxBatched){
+				// blocchi di batchSize elementi in ordine casuale
+				std::vector<std::tuple<unsigned int, unsigned int, double> > batches;
+				batches.reserve(nnz);
+				for(std::size_t k = 0; k < nnz; ++k)
+					batches.push_back(std::make_tuple(sorted[k].i, sorted[k].j, vals[k]));
+				std::shuffle(batches.begin(), batches.end(), gen);
+				ns = time_ns([&](){
+					matrix r(n, n, 0.0);
+					for(std::size_t k = 0; k < nnz; k += batchSize)
+						r.add_batch(batches.begin() + k, batches.begin() + std::min(nnz, k + batchSize));
+				}, nnz);
+				report(first, "add_batch_10k", n, perRow, nnz, ns, bytes);
+			}
+
+			// ------------- letture ----------------
+			std::vector<coord> hits(lookups), misses(lookups);
+			std::uniform_int_distribution<std::size_t> pick(0, nnz - 1);
+			for(std::size_t k = 0; k < lookups; ++k){
+				hits[k] = sorted[pick(gen)];
+				misses[k] = hits[k];
+				misses[k].j = (misses[k].j + 1) % n; // stride >= 2, la cella successiva e' vuota
+			}
+
+			ns = time_ns([&](){
+				double acc = 0;
+				for(std::size_t k = 0; k < lookups; ++k)
+					acc += m(hits[k].i, hits[k].j);
+				sink = acc;
+			}, lookups);
+			report(first, "lookup_hit", n, perRow, nnz, ns, bytes);
+
+			ns = time_ns([&](){
+				double acc = 0;
+				for(std::size_t k = 0; k < lookups; ++k)
+					acc += m(misses[k].i, misses[k].j);
+				sink = acc;
+			}, lookups);
+			report(first, "lookup_miss", n, perRow, nnz, ns, bytes);
+
+			std::vector<std::pair<unsigned int, unsigned int> > batch(lookups);
+			for(std::size_t k = 0; k < lookups; ++k)
+				batch[k] = std::make_pair(hits[k].i, hits[k].j);
+			std::vector<double> found(lookups);
+			ns = time_ns([&](){
+				m.lookup_batch(batch.data(), lookups, found.data());
+				sink = found[0];
+			}, lookups);
+			report(first, "lookup_batch_hit", n, perRow, nnz, ns, bytes);
+
+			// ------------- iterazione e copie ----------------
+			ns = time_ns([&](){
+				double acc = 0;
+				for(matrix::const_iterator i = m.begin(), ie = m.end(); i != ie; ++i)
+					acc += i -> value;
+				sink = acc;
+			}, nnz);
+			report(first, "iterate", n, perRow, nnz, ns, bytes);
+
+			ns = time_ns([&](){
+				matrix c(m);
+				sink = c.getNumElement();
+			}, nnz);
+			report(first, "copy", n, perRow, nnz, ns, bytes);
+
+			ns = time_ns([&](){
+				SparseMatrix<float, tracking_allocator<float> > c(m);
+				sink = c.getNumElement();
+			}, nnz);
+			report(first, "convert_double_float", n, perRow, nnz, ns, bytes);
+
+			// ------------- evaluate ----------------
+			ns = time_ns([&](){
+				sink = static_cast<double>(evaluate(m, greater_than_half()));
+			}, nnz);
+			report(first, "evaluate_seq", n, perRow, nnz, ns, bytes);
+
+			ns = time_ns([&](){
+				sink = static_cast<double>(evaluate(execution::par_unseq, m, greater_than_half()));
+			}, nnz);
+			report(first, "evaluate_par_unseq", n, perRow, nnz, ns, bytes);
+		}
+	}
+
+	std::cout << "\n  ]\n}" << std::endl;
+	return 0;
+}
@@ -2,7 +2,17 @@
 #include <vector>
 #include <cassert>
 #include <string>
+#include <tuple>
+#include <cstdint>
+#include <type_traits>
 #include "SparseMatrix.h"
+#include "CompressedMatrix.h"
+#include "DokMatrix.h"
+#include "MappedMatrix.h"
+#include "MatrixMarket.h"
+#include "ConcurrentMatrix.h"
+#include "SnapshotMatrix.h"
+#include <cstdio>
 
 void test_element(){
     std::cout << "**********TEST ELEMENT**********" << std::endl;
@@ -253,6 +263,1304 @@ void test_iterator(){
 }
 
 
+void test_ordering(){
+    std::cout << "**********TEST ORDINAMENTO**********" << std::endl;
+    SparseMatrix<int> sm(4,4,0);
+
+    // inserisco in ordine sparso, anche con colonne minori su righe successive
+    sm.add(3,0,30);
+    sm.add(0,3,3);
+    sm.add(1,0,10);
+    sm.add(0,1,1);
+    sm.add(2,2,22);
+    sm.add(1,0,11); // sovrascrittura
+    assert(sm.getNumElement() == 5);
+
+    // gli elementi devono essere ordinati per (i,j)
+    SparseMatrix<int>::const_iterator i = sm.begin(), ie = sm.end();
+    SparseMatrix<int>::const_iterator prev = i;
+    for(++i; i != ie; ++i, ++prev)
+        assert(prev->i < i->i || (prev->i == i->i && prev->j < i->j));
+
+    assert(sm(3,0) == 30);
+    assert(sm(0,3) == 3);
+    assert(sm(1,0) == 11);
+    assert(sm(0,1) == 1);
+    assert(sm(2,2) == 22);
+    assert(sm(3,3) == 0);
+}
+
+void test_compressed(){
+    std::cout << "**********TEST CSR/CSC**********" << std::endl;
+    SparseMatrix<int> sm(3,4,-1);
+    sm.add(2,1,21);
+    sm.add(0,3,3);
+    sm.add(0,0,0);
+    sm.add(2,3,23);
+
+    CsrMatrix<int> csr = freeze(sm);
+    CscMatrix<int> csc(sm);
+    assert(csr.getNumRows() == 3 && csc.getNumCols() == 4);
+    assert(csr.getNumElement() == 4 && csc.getNumElement() == 4);
+    assert(csr.getDefaultValue() == -1);
+
+    // stessi valori della matrice di origine
+    for(unsigned int i = 0; i < 3; ++i)
+        for(unsigned int j = 0; j < 4; ++j){
+            assert(csr(i,j) == sm(i,j));
+            assert(csc(i,j) == sm(i,j));
+        }
+
+    // fette di riga e colonna
+    CsrMatrix<int>::slice r = csr.row(2);
+    assert(r.size == 2 && r.index[0] == 1 && r.values[1] == 23);
+    assert(csr.row(1).size == 0);
+    CscMatrix<int>::slice c = csc.column(3);
+    assert(c.size == 2 && c.index[0] == 0 && c.index[1] == 2 && c.values[0] == 3);
+
+    // iterazione: CSR in ordine di riga, CSC in ordine di colonna
+    SparseMatrix<int>::const_iterator si = sm.begin();
+    for(CsrMatrix<int>::const_iterator i = csr.begin(); i != csr.end(); ++i, ++si)
+        assert(i->i == si->i && i->j == si->j && (*i).value == si->value);
+
+    CscMatrix<int>::const_iterator ci = csc.begin();
+    assert(ci->i == 0 && ci->j == 0);
+    ++ci;
+    assert(ci->i == 2 && ci->j == 1);
+    ci++;
+    assert(ci->i == 0 && ci->j == 3);
+
+    try{
+        csr(3,0);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+}
+
+void test_dok(){
+    std::cout << "**********TEST DOK**********" << std::endl;
+    DokMatrix<int> dok(100,50,7);
+
+    // inserimento in ordine casuale, con sovrascritture
+    for(unsigned int k = 0; k < 1000; ++k)
+        dok.add((k * 37) % 100, (k * 11) % 50, k);
+    assert(dok.getNumElement() == 100); // (37k mod 100, 11k mod 50) si ripete ogni 100
+    assert(dok(37,11) == 901);
+    assert(dok(0,1) == 7); // mai inserito
+
+    try{
+        dok.add(100,0,1);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+
+    // conversione ordinata
+    SparseMatrix<int> sm = dok.toSparseMatrix();
+    assert(sm.getNumElement() == dok.getNumElement());
+    assert(sm.getDefaultValue() == 7);
+    SparseMatrix<int>::const_iterator i = sm.begin(), prev = sm.begin();
+    for(++i; i != sm.end(); ++i, ++prev)
+        assert(prev->i < i->i || (prev->i == i->i && prev->j < i->j));
+    for(i = sm.begin(); i != sm.end(); ++i)
+        assert(dok(i->i, i->j) == i->value);
+
+    // tabella al limite del fattore di carico: le sovrascritture non la fanno crescere
+    DokMatrix<int> full(4,4,0);
+    for(unsigned int k = 0; k < 8; ++k)
+        full.add(k / 4, k % 4, k);
+    for(unsigned int k = 0; k < 8; ++k)
+        full.add(k / 4, k % 4, 10 * k);
+    full.add(3,3,1);
+    assert(full.getNumElement() == 9 && full(1,3) == 70 && full(3,3) == 1);
+    SparseMatrix<int> fs = full.toSparseMatrix();
+    assert(fs.getNumElement() == 9 && fs(1,3) == 70 && fs(3,3) == 1 && fs(2,2) == 0);
+}
+
+void test_row_index(){
+    std::cout << "**********TEST INDICE RIGHE**********" << std::endl;
+    SparseMatrix<int> sm(5,5,0);
+    sm.add(3,3,33);
+    sm.add(1,1,11);
+
+    // attivo l'indice su una matrice gia' piena
+    sm.setRowIndex(true);
+    assert(sm.hasRowIndex());
+    assert(sm(3,3) == 33 && sm(1,1) == 11 && sm(2,2) == 0);
+
+    // inserimenti in righe diverse aggiornano l'indice
+    sm.add(0,4,4);
+    sm.add(4,0,40);
+    sm.add(1,0,10);
+    sm.add(1,1,12); // sovrascrittura
+    sm.add(3,4,34);
+    assert(sm.getNumElement() == 6);
+    assert(sm(0,4) == 4 && sm(4,0) == 40 && sm(1,0) == 10);
+    assert(sm(1,1) == 12 && sm(3,4) == 34 && sm(3,3) == 33);
+    assert(sm(4,4) == 0 && sm(0,0) == 0);
+
+    // la copia mantiene l'indice
+    SparseMatrix<int> copy(sm);
+    assert(copy.hasRowIndex() && copy(3,4) == 34);
+    SparseMatrix<double> conv(sm);
+    assert(conv.hasRowIndex() && conv(4,0) == 40);
+
+    sm.setRowIndex(false);
+    assert(!sm.hasRowIndex());
+    assert(sm(3,4) == 34 && sm(2,0) == 0);
+}
+
+// tiene il valore massimo tra i duplicati
+struct max_value {
+    int operator()(int a, int b) const {
+        return a > b ? a : b;
+    }
+};
+
+void test_assign(){
+    std::cout << "**********TEST INSERIMENTO DI MASSA**********" << std::endl;
+    std::vector<std::tuple<unsigned int, unsigned int, int> > t;
+    t.push_back(std::make_tuple(2u, 0u, 5));
+    t.push_back(std::make_tuple(0u, 1u, 1));
+    t.push_back(std::make_tuple(2u, 0u, 7));
+    t.push_back(std::make_tuple(1u, 2u, 3));
+    t.push_back(std::make_tuple(2u, 0u, 6));
+
+    // costruttore, tiene l'ultimo valore
+    SparseMatrix<int> sm(3,3,0,t.begin(),t.end());
+    assert(sm.getNumElement() == 3);
+    assert(sm(2,0) == 6 && sm(0,1) == 1 && sm(1,2) == 3);
+    SparseMatrix<int>::const_iterator i = sm.begin();
+    assert(i->i == 0 && (++i)->i == 1 && (++i)->i == 2);
+
+    // somma dei duplicati, sostituisce il contenuto precedente
+    sm.add(1,1,100);
+    sm.assign(t.begin(), t.end(), SparseMatrix<int>::sum);
+    assert(sm.getNumElement() == 3);
+    assert(sm(2,0) == 18 && sm(1,1) == 0);
+
+    // riduzione personalizzata e indice delle righe
+    sm.setRowIndex(true);
+    sm.assign(t.begin(), t.end(), max_value());
+    assert(sm(2,0) == 7 && sm(1,2) == 3);
+    sm.add(1,0,10);
+    assert(sm(1,0) == 10 && sm(1,2) == 3);
+
+    // intervallo di element
+    SparseMatrix<double> copy(3,3,0.5,sm.begin(),sm.end());
+    assert(copy.getNumElement() == 4 && copy(1,0) == 10.0);
+
+    // un indice non valido non modifica la matrice
+    t.push_back(std::make_tuple(3u, 0u, 1));
+    try{
+        sm.assign(t.begin(), t.end());
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){
+        assert(sm.getNumElement() == 4);
+    }
+
+    // intervallo gia' ordinato: nessun ordinamento, duplicati e disordine rifiutati
+    SparseMatrix<int> sorted(3,3,0);
+    sorted.assign_sorted(sm.begin(), sm.end());
+    assert(sorted.getNumElement() == 4 && sorted(1,0) == 10 && sorted(2,0) == 7);
+    std::vector<std::tuple<unsigned int, unsigned int, int> > s;
+    s.push_back(std::make_tuple(0u, 2u, 1));
+    s.push_back(std::make_tuple(1u, 0u, 2));
+    s.push_back(std::make_tuple(1u, 0u, 3));
+    try{
+        sorted.assign_sorted(s.begin(), s.end());
+        assert(false);
+    }
+    catch(unsorted_range_exception &e){
+        assert(sorted.getNumElement() == 4);
+    }
+    s.pop_back();
+    sorted.assign_sorted(s.begin(), s.end());
+    assert(sorted.getNumElement() == 2 && sorted(0,2) == 1 && sorted(1,0) == 2 && sorted(2,0) == 0);
+}
+
+unsigned int allocations = 0; // numero di allocazioni fatte da counting_allocator
+
+// allocatore che conta le allocazioni
+template <typename T>
+struct counting_allocator {
+    typedef T value_type;
+
+    counting_allocator() {}
+    template <typename U>
+    counting_allocator(const counting_allocator<U> &) {}
+
+    T *allocate(size_t n){
+        ++allocations;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, size_t n){
+        std::allocator<T>().deallocate(p, n);
+    }
+    template <typename U>
+    bool operator==(const counting_allocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const counting_allocator<U> &) const { return false; }
+};
+
+void test_allocator(){
+    std::cout << "**********TEST ALLOCATORE**********" << std::endl;
+    allocations = 0;
+    SparseMatrix<int, counting_allocator<int> > sm(10,10,0);
+    for(unsigned int i = 0; i < 10; ++i)
+        sm.add(i,i,i);
+    assert(allocations > 0);
+    assert(sm(5,5) == 5);
+
+    // tutte le copie usano lo stesso tipo di allocatore
+    unsigned int before = allocations;
+    SparseMatrix<int, counting_allocator<int> > copy(sm);
+    assert(allocations > before && copy(9,9) == 9);
+    SparseMatrix<double> conv(sm);
+    assert(conv(3,3) == 3.0);
+    SparseMatrix<int, counting_allocator<int> > back(conv);
+    assert(back(4,4) == 4);
+
+    CsrMatrix<int> csr = freeze(sm);
+    assert(csr(7,7) == 7);
+    assert(evaluate(sm, is_even()) == 95);
+}
+
+// ritorna una matrice per valore, usata per provare lo spostamento
+SparseMatrix<int> make_diagonal(unsigned int n){
+    SparseMatrix<int> sm(n,n,0);
+    for(unsigned int i = 0; i < n; ++i)
+        sm.add(i,i,1);
+    return sm;
+}
+
+void test_move(){
+    std::cout << "**********TEST SPOSTAMENTO E SCAMBIO**********" << std::endl;
+    SparseMatrix<int> a = make_diagonal(4);
+    assert(a.getNumElement() == 4 && a(3,3) == 1);
+
+    // costruttore per spostamento: b prende gli elementi, a rimane vuota
+    SparseMatrix<int> b(std::move(a));
+    assert(b.getNumElement() == 4 && b(2,2) == 1);
+    assert(a.getNumElement() == 0 && a.begin() == a.end());
+
+    // assegnamento per spostamento
+    SparseMatrix<int> c(2,2,5);
+    c = std::move(b);
+    assert(c.getNumRows() == 4 && c.getNumElement() == 4 && c(1,1) == 1);
+
+    // scambio
+    SparseMatrix<int> d(2,3,7);
+    d.add(1,2,12);
+    c.swap(d);
+    assert(c.getNumRows() == 2 && c(1,2) == 12 && c.getDefaultValue() == 7);
+    assert(d.getNumRows() == 4 && d(0,0) == 1);
+    swap(c, d);
+    assert(c.getNumRows() == 4 && d.getNumRows() == 2);
+
+    // le matrici si possono tenere in un vector senza copie degli elementi
+    std::vector<SparseMatrix<int> > v;
+    v.push_back(make_diagonal(3));
+    v.push_back(make_diagonal(5));
+    assert(v[1](4,4) == 1 && v[0].getNumElement() == 3);
+
+    // la copia mantiene ordine e valori
+    SparseMatrix<int> e(v[1]);
+    SparseMatrix<int>::const_iterator i = e.begin(), j = v[1].begin();
+    for(; i != e.end(); ++i, ++j)
+        assert(i->i == j->i && i->j == j->j && i->value == j->value);
+}
+
+void test_multiply(){
+    std::cout << "**********TEST PRODOTTO MATRICE-VETTORE**********" << std::endl;
+    // matrice 4x3 con valore di default 0
+    SparseMatrix<double> sm(4,3,0);
+    sm.add(0,0,1);
+    sm.add(0,2,2);
+    sm.add(2,1,3);
+    sm.add(3,0,4);
+    sm.add(3,2,5);
+
+    std::vector<double> x(3);
+    x[0] = 1; x[1] = 2; x[2] = 3;
+    std::vector<double> y = sm.multiply(x);
+    assert(y.size() == 4);
+    assert(y[0] == 7 && y[1] == 0 && y[2] == 6 && y[3] == 19);
+
+    // valore di default non nullo: ogni cella non inserita vale 1
+    SparseMatrix<double> ones(4,3,1);
+    ones.add(0,0,1);
+    ones.add(1,1,0);
+    ones.add(2,2,4);
+    y = ones.multiply(x);
+    assert(y[0] == 6 && y[1] == 4 && y[2] == 15 && y[3] == 6);
+
+    // versioni compresse
+    std::vector<double> yc = freeze(ones).multiply(x);
+    assert(yc == y);
+    yc = CscMatrix<double>(ones).multiply(x);
+    assert(yc == y);
+
+    try{
+        sm.multiply(std::vector<double>(2));
+        assert(false);
+    }
+    catch(dimension_mismatch_exception &e){}
+
+    // piu' thread danno lo stesso risultato, anche con righe vuote
+    SparseMatrix<double> big(300,200,0.5);
+    for(unsigned int i = 0; i < 300; i += 3)
+        for(unsigned int j = 0; j < 200; j += (i % 7) + 1)
+            big.add(i,j,(i + j) % 5);
+    std::vector<double> xb(200);
+    for(unsigned int j = 0; j < 200; ++j)
+        xb[j] = j % 4;
+    std::vector<double> y1 = big.multiply(xb, 1);
+    assert(big.multiply(xb, 4) == y1);
+    assert(big.multiply(xb, 0) == y1);
+    CsrMatrix<double> bigCsr(big);
+    assert(bigCsr.multiply(xb, 3) == y1);
+    assert(CscMatrix<double>(big).multiply(xb) == y1);
+}
+
+// confronta il kernel vettorizzato con il prodotto scalare di riferimento
+template <typename T>
+void check_kernel(typename spmv_simd::kernel<T>::type kernel){
+    const unsigned int n = 37; // non multiplo della larghezza dei vettori
+    std::vector<T> x(100);
+    for(unsigned int k = 0; k < x.size(); ++k)
+        x[k] = static_cast<T>(k % 9) / 4;
+
+    // elementi in array separati (CSR) e in array di strutture (SparseMatrix)
+    std::vector<unsigned int> index(n);
+    std::vector<T> values(n);
+    SparseMatrix<T> sm(1,100,0);
+    for(unsigned int k = 0; k < n; ++k){
+        index[k] = (k * 13) % 100;
+        values[k] = static_cast<T>(k % 5) - 1;
+        sm.add(0,index[k],values[k]);
+    }
+
+    T shift = 0.5;
+    T ref = spmv_scalar_dot<T>(index.data(), sizeof(unsigned int), values.data(), sizeof(T), n, x.data(), shift, true);
+    T res = kernel(index.data(), sizeof(unsigned int), values.data(), sizeof(T), n, x.data(), shift);
+    assert(res - ref < 1e-3 && ref - res < 1e-3);
+
+    const typename SparseMatrix<T>::element &e = *sm.begin();
+    ref = spmv_scalar_dot<T>(&e.j, sizeof(e), &e.value, sizeof(e), n, x.data(), shift, true);
+    res = kernel(&e.j, sizeof(e), &e.value, sizeof(e), n, x.data(), shift);
+    assert(res - ref < 1e-3 && ref - res < 1e-3);
+}
+
+void test_simd(){
+    std::cout << "**********TEST KERNEL SIMD**********" << std::endl;
+#ifdef SPMV_X86_KERNELS
+    // provo tutti i kernel supportati dal processore
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse2")){
+        check_kernel<float>(&spmv_simd::sse2);
+        check_kernel<double>(&spmv_simd::sse2);
+    }
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+        check_kernel<float>(&spmv_simd::avx2);
+        check_kernel<double>(&spmv_simd::avx2);
+    }
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2")){
+        check_kernel<float>(&spmv_simd::avx512);
+        check_kernel<double>(&spmv_simd::avx512);
+    }
+#endif
+
+    // float con righe lunghe: stesso risultato di CSR e del tipo generico
+    SparseMatrix<float> sm(20,300,0.25f);
+    for(unsigned int i = 0; i < 20; ++i)
+        for(unsigned int j = i; j < 300; j += (i % 3) + 1)
+            sm.add(i,j,static_cast<float>((i * j) % 7));
+    std::vector<float> x(300, 0.5f);
+    std::vector<float> y = sm.multiply(x);
+    std::vector<float> yc = freeze(sm).multiply(x, 2);
+
+    SparseMatrix<long double> generic(sm);
+    std::vector<long double> xg(300, 0.5);
+    std::vector<long double> yg = generic.multiply(xg);
+    for(unsigned int i = 0; i < 20; ++i){
+        assert(y[i] - yc[i] < 1e-2 && yc[i] - y[i] < 1e-2);
+        assert(y[i] - yg[i] < 1e-2 && yg[i] - y[i] < 1e-2);
+    }
+}
+
+void test_spgemm(){
+    std::cout << "**********TEST PRODOTTO TRA MATRICI**********" << std::endl;
+    SparseMatrix<int> a(3,4,0);
+    a.add(0,0,1);
+    a.add(0,3,2);
+    a.add(2,1,3);
+    SparseMatrix<int> b(4,2,0);
+    b.add(0,1,4);
+    b.add(1,0,5);
+    b.add(3,1,6);
+    b.add(2,0,7);
+
+    SparseMatrix<int> c = a * b;
+    assert(c.getNumRows() == 3 && c.getNumCols() == 2);
+    assert(c.getNumElement() == 2);
+    assert(c(0,1) == 16 && c(2,0) == 15 && c(0,0) == 0 && c(1,1) == 0);
+
+    // confronto con il prodotto denso, sequenziale e parallelo
+    SparseMatrix<long> x(40,30,0), y(30,50,0);
+    for(unsigned int k = 0; k < 300; ++k){
+        x.add((k * 7) % 40, (k * 11) % 30, k % 9 + 1);
+        y.add((k * 13) % 30, (k * 17) % 50, k % 5 + 1);
+    }
+    SparseMatrix<long> z1 = x.multiply(y, 1);
+    SparseMatrix<long> z4 = x.multiply(y, 4);
+    assert(z1.getNumElement() == z4.getNumElement());
+    for(unsigned int i = 0; i < 40; ++i)
+        for(unsigned int j = 0; j < 50; ++j){
+            long dense = 0;
+            for(unsigned int k = 0; k < 30; ++k)
+                dense += x(i,k) * y(k,j);
+            assert(z1(i,j) == dense && z4(i,j) == dense);
+        }
+    SparseMatrix<long>::const_iterator i = z4.begin(), prev = z4.begin();
+    for(++i; i != z4.end(); ++i, ++prev)
+        assert(prev->i < i->i || (prev->i == i->i && prev->j < i->j));
+
+    try{
+        b * a;
+        assert(false);
+    }
+    catch(dimension_mismatch_exception &e){}
+
+    SparseMatrix<int> ones(4,2,1);
+    try{
+        a * ones;
+        assert(false);
+    }
+    catch(default_value_exception &e){}
+}
+
+// massimo tra due valori
+struct max_of {
+    int operator()(int a, int b) const {
+        return a > b ? a : b;
+    }
+};
+
+void test_add_batch(){
+    std::cout << "**********TEST INSERIMENTO A BLOCCHI**********" << std::endl;
+    SparseMatrix<int> sm(40,30,0), ref(40,30,0);
+    for(unsigned int k = 0; k < 300; ++k){
+        sm.add((k * 7) % 40, (k * 11) % 30, k);
+        ref.add((k * 7) % 40, (k * 11) % 30, k);
+    }
+
+    // blocco non ordinato, con duplicati interni e coordinate gia' presenti
+    std::vector<std::tuple<unsigned int, unsigned int, int> > batch;
+    for(unsigned int k = 0; k < 500; ++k)
+        batch.push_back(std::make_tuple((k * 13) % 40, (k * 17) % 30, -static_cast<int>(k)));
+
+    SparseMatrix<int> summed(sm);
+    sm.add_batch(batch.begin(), batch.end());
+    for(size_t k = 0; k < batch.size(); ++k)
+        ref.add(std::get<0>(batch[k]), std::get<1>(batch[k]), std::get<2>(batch[k]));
+    assert(sm.getNumElement() == ref.getNumElement());
+    SparseMatrix<int>::const_iterator r = ref.begin();
+    for(SparseMatrix<int>::const_iterator k = sm.begin(); k != sm.end(); ++k, ++r)
+        assert(k -> i == r -> i && k -> j == r -> j && k -> value == r -> value);
+
+    // sum somma anche il valore gia' presente, con l'indice delle righe attivo
+    summed.setRowIndex(true);
+    SparseMatrix<int> before(summed);
+    summed.add_batch(batch.begin(), batch.end(), SparseMatrix<int>::sum);
+    for(unsigned int i = 0; i < 40; ++i)
+        for(unsigned int j = 0; j < 30; ++j){
+            int expected = before(i,j);
+            for(size_t k = 0; k < batch.size(); ++k)
+                if(std::get<0>(batch[k]) == i && std::get<1>(batch[k]) == j)
+                    expected += std::get<2>(batch[k]);
+            assert(summed(i,j) == expected);
+        }
+
+    // riduzione personalizzata e una sola allocazione
+    SparseMatrix<int, std::allocator<int>, unsigned int, counting_instrumentation> counted(2,2,0);
+    counted.add(0,0,5);
+    counted.resetStats();
+    std::vector<std::tuple<int, int, int> > small;
+    small.push_back(std::make_tuple(0,0,3));
+    small.push_back(std::make_tuple(1,1,4));
+    small.push_back(std::make_tuple(0,0,9));
+    counted.add_batch(small.begin(), small.end(), max_of());
+    assert(counted(0,0) == 9 && counted(1,1) == 4 && counted.getNumElement() == 2);
+    assert(counted.getStats().allocations == 1);
+
+    // indice fuori dai limiti: la matrice non cambia
+    small.push_back(std::make_tuple(2,0,1));
+    try{
+        counted.add_batch(small.begin(), small.end());
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+    assert(counted(0,0) == 9 && counted.getNumElement() == 2);
+}
+
+void test_lookup_batch(){
+    std::cout << "**********TEST LETTURA A BLOCCHI**********" << std::endl;
+    SparseMatrix<int, std::allocator<int>, unsigned int, counting_instrumentation> sm(100,80,-1);
+    for(unsigned int k = 0; k < 2000; ++k)
+        sm.add((k * 37) % 100, (k * 53) % 80, k);
+
+    // richieste non ordinate, ripetute, presenti e assenti
+    std::vector<std::pair<unsigned int, unsigned int> > coords;
+    for(unsigned int k = 0; k < 5000; ++k)
+        coords.push_back(std::make_pair((k * 71) % 100, (k * 29) % 80));
+    coords.push_back(std::make_pair(99u, 79u));
+    coords.push_back(std::make_pair(0u, 0u));
+
+    for(unsigned int threads = 1; threads <= 4; threads += 3){
+        sm.resetStats();
+        std::vector<int> values = sm.lookup_batch(coords, threads);
+        assert(values.size() == coords.size());
+        assert(sm.getStats().lookups == coords.size());
+        for(size_t q = 0; q < coords.size(); ++q)
+            assert(values[q] == sm(coords[q].first, coords[q].second));
+    }
+
+    // poche richieste su una matrice vuota, piu' thread che richieste
+    SparseMatrix<int> empty(3,3,7);
+    std::vector<std::pair<unsigned int, unsigned int> > few(1, std::make_pair(2u, 2u));
+    assert(empty.lookup_batch(few, 8)[0] == 7);
+    assert(empty.lookup_batch(std::vector<std::pair<unsigned int, unsigned int> >(), 0).empty());
+
+    // richiesta fuori dai limiti: nessun valore scritto
+    int out[2] = { 42, 42 };
+    std::pair<unsigned int, unsigned int> bad[2] = { std::make_pair(0u, 0u), std::make_pair(3u, 0u) };
+    try{
+        empty.lookup_batch(bad, 2, out);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+    assert(out[0] == 42);
+}
+
+// mi dice se un elemento sta nelle prime 5 colonne
+struct first_columns {
+    bool operator()(const SparseMatrix<int>::element &e) const {
+        return e.j < 5;
+    }
+};
+
+void test_erase(){
+    std::cout << "**********TEST RIMOZIONE**********" << std::endl;
+    SparseMatrix<int> sm(20,20,0), ref(20,20,0);
+    for(unsigned int k = 0; k < 150; ++k){
+        sm.add((k * 7) % 20, (k * 3) % 20, k % 4);
+        ref.add((k * 7) % 20, (k * 3) % 20, k % 4);
+    }
+    sm.setRowIndex(true);
+
+    const size_t n = sm.getNumElement();
+    SparseMatrix<int>::const_iterator e = sm.begin();
+    ++e;
+    const unsigned int ei = e -> i, ej = e -> j;
+    assert(sm.erase(ei, ej) && !sm.erase(ei, ej));
+    assert(sm.getNumElement() == n - 1 && sm(ei, ej) == 0);
+
+    // erase con iteratore restituisce l'elemento successivo
+    for(SparseMatrix<int>::iterator k = sm.begin(); k != sm.end(); ){
+        if(k -> i == 3)
+            k = sm.erase(k);
+        else
+            ++k;
+    }
+    for(unsigned int j = 0; j < 20; ++j)
+        assert(sm(3,j) == 0);
+
+    const size_t dropped = sm.erase_if(first_columns());
+    const size_t zeros = sm.prune();
+    assert(dropped > 0 && zeros > 0);
+    for(SparseMatrix<int>::const_iterator k = sm.begin(); k != sm.end(); ++k)
+        assert(k -> j >= 5 && k -> value != 0);
+    for(unsigned int i = 0; i < 20; ++i)
+        for(unsigned int j = 0; j < 20; ++j)
+            assert(sm(i,j) == ((i == 3 || j < 5 || (i == ei && j == ej)) ? 0 : ref(i,j)));
+
+    // l'indice delle righe, attivo dall'inizio, resta coerente
+    sm.add(19,19,1);
+    assert(sm(19,19) == 1 && sm.erase(19,19));
+
+    // shrink_to_fit restituisce la memoria
+    SparseMatrix<int, std::allocator<int>, unsigned int, counting_instrumentation> c(4,4,0);
+    for(unsigned int k = 0; k < 5; ++k)
+        c.add(k % 4, k / 4, 1);
+    c.erase_if([](const SparseMatrix<int, std::allocator<int>, unsigned int, counting_instrumentation>::element &x){ return x.i > 0; });
+    c.resetStats();
+    c.shrink_to_fit();
+    assert(c.getStats().allocated == 2 && c.getNumElement() == 2 && c(0,1) == 1);
+    c.shrink_to_fit();
+    assert(c.getStats().allocations == 1);
+    c.erase_if([](const SparseMatrix<int, std::allocator<int>, unsigned int, counting_instrumentation>::element &){ return true; });
+    c.shrink_to_fit();
+    assert(c.getNumElement() == 0 && c(0,0) == 0 && c.begin() == c.end());
+
+    // valori la cui copia puo' fallire: la rimozione copia in un nuovo array
+    SparseMatrix<std::string> str(3,3,"");
+    str.add(0,0,"a");
+    str.add(1,1,"");
+    str.add(2,2,"c");
+    assert(str.prune() == 1 && str.getNumElement() == 2 && str(2,2) == "c");
+    assert(str.erase(0,0) && str(0,0) == "" && str.getNumElement() == 1);
+
+    // anche in quel caso la capacita' non cambia e si copiano solo gli elementi rimasti
+    SparseMatrix<std::string, std::allocator<std::string>, unsigned int, counting_instrumentation> cs(8,8,"");
+    for(unsigned int k = 0; k < 8; ++k)
+        cs.add(k, k, std::string(1, static_cast<char>('a' + k)));
+    cs.resetStats();
+    assert(cs.erase(3,3) && cs.getStats().allocated == 8 && cs.getStats().copied == 7);
+    assert(cs.erase(cs.begin()) -> value == "b");
+    assert(cs.erase_if([](const SparseMatrix<std::string, std::allocator<std::string>, unsigned int, counting_instrumentation>::element &x){ return x.i > 5; }) == 2);
+    assert(cs.getStats().allocations == 3 && cs.getStats().allocated == 24 && cs.getNumElement() == 4);
+    assert(cs(4,4) == "e" && cs(3,3) == "" && cs(0,0) == "" && cs(6,6) == "");
+
+    try{
+        sm.erase(20,0);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+}
+
+void test_elementwise(){
+    std::cout << "**********TEST OPERAZIONI ELEMENTO PER ELEMENTO**********" << std::endl;
+    SparseMatrix<int> a(3,3,1);
+    a.add(0,0,5);
+    a.add(1,2,2);
+    a.add(2,2,4);
+    SparseMatrix<int> b(3,3,2);
+    b.add(0,0,3);
+    b.add(2,1,7);
+    b.add(2,2,-2);
+
+    SparseMatrix<int> sum = a + b;
+    assert(sum.getDefaultValue() == 3);
+    assert(sum.getNumElement() == 4); // unione delle celle inserite
+    for(unsigned int i = 0; i < 3; ++i)
+        for(unsigned int j = 0; j < 3; ++j){
+            assert(sum(i,j) == a(i,j) + b(i,j));
+            assert((a - b)(i,j) == a(i,j) - b(i,j));
+            assert(elementwise_multiply(a,b)(i,j) == a(i,j) * b(i,j));
+            assert(zip_with(a,b,max_of())(i,j) == std::max(a(i,j), b(i,j)));
+        }
+
+    // (2,2): 4 + (-2) = 2 diverso dal default 3, (0,0): 8; nessun elemento uguale al default
+    assert(zip_with(a,b,std::plus<int>(),true).getNumElement() == 4);
+    // prodotto: (1,2) = 2*2 = 4, (2,1) = 1*7, (2,2) = -8, (0,0) = 15; default 2
+    SparseMatrix<int> c(3,3,0);
+    c.add(0,1,0);
+    c.add(1,1,3);
+    SparseMatrix<int> d(3,3,0);
+    d.add(1,1,2);
+    d.add(2,0,9);
+    SparseMatrix<int> h = elementwise_multiply(c,d,true);
+    assert(h.getNumElement() == 1 && h(1,1) == 6);
+    assert(elementwise_multiply(c,d).getNumElement() == 3);
+
+    try{
+        a + SparseMatrix<int>(3,4,0);
+        assert(false);
+    }
+    catch(dimension_mismatch_exception &e){}
+}
+
+void test_expression(){
+    std::cout << "**********TEST ESPRESSIONI**********" << std::endl;
+    SparseMatrix<int> a(6,5,1), b(6,5,0), c(6,5,2);
+    for(unsigned int k = 0; k < 12; ++k){
+        a.add(k % 6, (k * 3) % 5, k);
+        b.add((k * 5) % 6, k % 5, -static_cast<int>(k));
+        c.add((k * 7) % 6, (k * 2) % 5, 3 * k);
+    }
+
+    // una sola fusione a tre vie e una sola allocazione
+    SparseMatrix<int, std::allocator<int>, unsigned int, counting_instrumentation> ca(a), cb(b), cc(c);
+    SparseMatrix<int, std::allocator<int>, unsigned int, counting_instrumentation> r = 2 * ca + cb * 3 - cc;
+    assert(r.getStats().allocations == 1);
+    assert(r.getDefaultValue() == 2 * 1 + 0 * 3 - 2);
+    for(unsigned int i = 0; i < 6; ++i)
+        for(unsigned int j = 0; j < 5; ++j){
+            assert(r(i,j) == 2 * a(i,j) + 3 * b(i,j) - c(i,j));
+            assert((a - -b)(i,j) == a(i,j) + b(i,j)); // valutazione pigra di una cella
+        }
+
+    // le posizioni sono l'unione di quelle delle matrici, come con zip_with
+    SparseMatrix<int> sum = a + b;
+    SparseMatrix<int> zipped = a.zip_with(b, std::plus<int>());
+    assert(sum.getNumElement() == zipped.getNumElement());
+    SparseMatrix<int>::const_iterator z = zipped.begin();
+    for(SparseMatrix<int>::const_iterator k = sum.begin(); k != sum.end(); ++k, ++z)
+        assert(k -> i == z -> i && k -> j == z -> j && k -> value == z -> value);
+
+    // dropDefault, stessa matrice due volte e assegnamento che contiene this
+    assert((a - a).eval(true).getNumElement() == 0);
+    SparseMatrix<int> d(a);
+    d = d + a;
+    for(unsigned int i = 0; i < 6; ++i)
+        for(unsigned int j = 0; j < 5; ++j)
+            assert(d(i,j) == 2 * a(i,j));
+
+    try{
+        a + SparseMatrix<int>(5,5,0) - b;
+        assert(false);
+    }
+    catch(dimension_mismatch_exception &e){}
+}
+
+void test_transpose(){
+    std::cout << "**********TEST TRASPOSTA**********" << std::endl;
+    SparseMatrix<int> sm(3,4,1);
+    sm.add(0,3,5);
+    sm.add(0,1,2);
+    sm.add(1,0,7);
+    sm.add(2,1,-3);
+    sm.add(2,3,4);
+
+    SparseMatrix<int> t = sm.transpose();
+    assert(t.getNumRows() == 4 && t.getNumCols() == 3);
+    assert(t.getNumElement() == sm.getNumElement());
+    assert(t.getDefaultValue() == 1);
+    for(unsigned int i = 0; i < 3; ++i)
+        for(unsigned int j = 0; j < 4; ++j)
+            assert(t(j,i) == sm(i,j));
+
+    // la trasposta e' ordinata per righe
+    SparseMatrix<int>::const_iterator i = t.begin(), ie = t.end(), prev = i;
+    for(++i; i != ie; ++i, ++prev)
+        assert(prev -> i < i -> i || (prev -> i == i -> i && prev -> j < i -> j));
+
+    SparseMatrix<int>::transposed_view v = sm.transposed();
+    assert(v.getNumRows() == 4 && v.getNumCols() == 3);
+    for(unsigned int i = 0; i < 4; ++i)
+        for(unsigned int j = 0; j < 3; ++j)
+            assert(v(i,j) == t(i,j));
+
+    unsigned int n = 0;
+    for(SparseMatrix<int>::transposed_view::const_iterator k = v.begin(), ke = v.end(); k != ke; ++k, ++n)
+        assert(t(k -> i, k -> j) == (*k).value);
+    assert(n == sm.getNumElement());
+
+    // A^T x dalla vista coincide con il prodotto della trasposta
+    std::vector<int> x(3);
+    x[0] = 1; x[1] = -2; x[2] = 3;
+    assert(v.multiply(x) == t.multiply(x));
+
+    sm.setRowIndex(true);
+    assert(sm.transpose().hasRowIndex());
+    assert(SparseMatrix<int>(0,5,0).transpose().getNumRows() == 5);
+}
+
+void test_submatrix(){
+    std::cout << "**********TEST VISTA SU UN BLOCCO**********" << std::endl;
+    SparseMatrix<int> sm(50,40,-1);
+    for(unsigned int k = 0; k < 600; ++k)
+        sm.add((k * 7) % 50, (k * 13) % 40, k);
+
+    for(int pass = 0; pass < 2; ++pass){
+        sm.setRowIndex(pass == 1);
+        SparseMatrix<int>::submatrix_view v = sm.submatrix(10,30,5,25);
+        assert(v.getNumRows() == 20 && v.getNumCols() == 20 && v.getDefaultValue() == -1);
+
+        // l'iterazione restituisce in ordine tutti e soli gli elementi del blocco
+        unsigned int expected = 0;
+        for(SparseMatrix<int>::const_iterator e = sm.begin(); e != sm.end(); ++e)
+            if(e -> i >= 10 && e -> i < 30 && e -> j >= 5 && e -> j < 25)
+                ++expected;
+        SparseMatrix<int>::submatrix_view::const_iterator k = v.begin(), ke = v.end();
+        for(unsigned int n = 0; n < expected; ++n, ++k){
+            assert(k != ke && k -> i < 20 && k -> j < 20);
+            assert(sm(k -> i + 10, k -> j + 5) == (*k).value);
+        }
+        assert(k == ke && v.getNumElement() == expected);
+
+        for(unsigned int i = 0; i < 20; ++i)
+            for(unsigned int j = 0; j < 20; ++j)
+                assert(v(i,j) == sm(i + 10, j + 5));
+
+        // vista di una vista
+        SparseMatrix<int>::submatrix_view w = v.submatrix(2,8,3,4);
+        assert(w.getNumRows() == 6 && w.getNumCols() == 1);
+        for(unsigned int i = 0; i < 6; ++i)
+            assert(w(i,0) == sm(i + 12, 8));
+        for(SparseMatrix<int>::submatrix_view::const_iterator c = w.begin(); c != w.end(); ++c)
+            assert(c -> j == 0 && sm(c -> i + 12, 8) == c -> value);
+
+        SparseMatrix<int> copy = w.materialize();
+        assert(copy.getNumRows() == 6 && copy.getNumElement() == w.getNumElement());
+        for(unsigned int i = 0; i < 6; ++i)
+            assert(copy(i,0) == w(i,0));
+    }
+
+    // iteratori di una vista temporanea e di copie della stessa vista
+    unsigned int counted = 0;
+    for(SparseMatrix<int>::submatrix_view::const_iterator t = sm.submatrix(10,30,5,25).begin(); t != sm.submatrix(10,30,5,25).end(); ++t){
+        assert(t -> i < 20 && t -> j < 20 && sm(t -> i + 10, t -> j + 5) == t -> value);
+        ++counted;
+    }
+    assert(counted == sm.submatrix(10,30,5,25).getNumElement());
+    SparseMatrix<int>::submatrix_view a = sm.submatrix(0,20,0,20), b = a;
+    assert(a.begin() == b.begin() && a.end() == b.end());
+
+    SparseMatrix<int>::submatrix_view empty = sm.submatrix(3,3,0,40);
+    assert(empty.begin() == empty.end());
+    assert(sm.submatrix(0,50,0,40).getNumElement() == sm.getNumElement());
+
+    try{
+        sm.submatrix(0,51,0,10);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+    try{
+        sm.submatrix(0,10,0,10)(10,0);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+}
+
+// mi dice se un intero e' minore di 3
+struct less_than_3 {
+	bool operator()(int value) const {
+		return value < 3;
+	}
+};
+
+void test_evaluate_policy(){
+    std::cout << "**********TEST EVALUATE PARALLELO**********" << std::endl;
+    SparseMatrix<int> sm(40,50,8);
+    for(unsigned int k = 0; k < 500; ++k)
+        sm.add((k * 7) % 40, (k * 13) % 50, static_cast<int>(k % 11) - 3);
+
+    const unsigned long long expected = evaluate(sm, less_than_3());
+    assert(evaluate(execution::seq, sm, less_than_3()) == expected);
+    assert(evaluate(execution::par, sm, less_than_3()) == expected);
+    assert(evaluate(execution::par_unseq, sm, less_than_3()) == expected);
+    for(unsigned int t = 1; t <= 5; ++t){
+        assert(evaluate(execution::par(t), sm, is_even()) == evaluate(sm, is_even()));
+        assert(evaluate(execution::par_unseq(t), sm, is_even()) == evaluate(sm, is_even()));
+    }
+
+    // tipo non aritmetico con par_unseq
+    People p0(10,11.3);
+    SparseMatrix<People> smp(3,3,p0);
+    smp.add(1,1,People(5,1.0));
+    assert(evaluate(execution::par_unseq(2), smp, test_people()) == 8);
+
+    // il numero di celle supera i 32 bit
+    SparseMatrix<int> big(100000,100000,0);
+    big.add(0,0,1);
+    big.add(99999,99999,2);
+    assert(evaluate(big, is_even()) == 10000000000ULL - 1);
+    assert(evaluate(execution::par(4), big, is_even()) == 10000000000ULL - 1);
+    assert(evaluate(execution::par_unseq, SparseMatrix<int>(0,0,0), is_even()) == 0);
+}
+
+void test_index_type(){
+    std::cout << "**********TEST TIPO DEGLI INDICI**********" << std::endl;
+    typedef SparseMatrix<float, std::allocator<float>, uint16_t> tile;
+    typedef SparseMatrix<int, std::allocator<int>, unsigned long long> huge;
+    assert(sizeof(tile::element) < sizeof(SparseMatrix<float>::element));
+
+    // piu' elementi di quanti ne rappresenti uint16_t
+    tile t(260,260,0.0f);
+    for(unsigned int i = 0; i < 260; ++i)
+        for(unsigned int j = 0; j < 260; ++j)
+            t.add(i, j, static_cast<float>((i + j) % 5));
+    assert(t.getNumElement() == 260u * 260u);
+    assert(t(259,259) == 3.0f);
+
+    // il prodotto con indici a 16 bit usa il ciclo scalare e coincide con quello a 32 bit
+    SparseMatrix<float> wide(t);
+    std::vector<float> x(260, 1.0f);
+    assert(t.multiply(x) == wide.multiply(x));
+    assert(tile(wide).getNumElement() == t.getNumElement());
+    assert(freeze(t)(17,42) == t(17,42));
+
+    // dimensione massima rappresentabile, con l'indice delle righe attivo
+    tile edge(65535,65535,1.0f);
+    edge.setRowIndex(true);
+    edge.add(65534,65534,2.0f);
+    edge.add(0,0,3.0f);
+    assert(edge(65534,65534) == 2.0f && edge(0,0) == 3.0f && edge(100,7) == 1.0f);
+
+    std::vector<std::tuple<int,int,float> > in;
+    in.push_back(std::make_tuple(70000, 0, 1.0f));
+    try{
+        edge.assign(in.begin(), in.end());
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+
+    // coordinate a 64 bit
+    huge h(5000000000ULL, 3000000000ULL, 0);
+    h.add(4999999999ULL, 2999999999ULL, 7);
+    h.add(4294967296ULL, 1, 5);
+    assert(h(4999999999ULL, 2999999999ULL) == 7);
+    assert(h(4294967296ULL, 1) == 5 && h(0, 1) == 0);
+    assert(evaluate(h, is_even()) == 15000000000000000000ULL - 2);
+    // CSR con colonne oltre 2^32: stesso tipo delle coordinate della matrice
+    huge flat(4, 5000000000ULL, 0);
+    flat.add(3, 4999999999ULL, 7);
+    flat.add(0, 4294967296ULL, 5);
+    CsrMatrix<int, unsigned long long> frozen = freeze(flat);
+    assert(frozen.getNumCols() == 5000000000ULL && frozen.getNumElement() == 2);
+    assert(frozen(3, 4999999999ULL) == 7 && frozen(0, 4294967296ULL) == 5 && frozen(0, 0) == 0);
+    assert(frozen.begin() -> j == 4294967296ULL && frozen.row(3).index[0] == 4999999999ULL);
+    huge overflow(5000000000ULL, 5000000000ULL, 0);
+    try{
+        evaluate(overflow, is_even());
+        assert(false);
+    }
+    catch(std::overflow_error &e){}
+    try{
+        evaluate(execution::par, overflow, is_even());
+        assert(false);
+    }
+    catch(std::overflow_error &e){}
+    try{
+        h.add(5000000000ULL, 0, 1);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+    try{
+        SparseMatrix<int> narrow(h);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+}
+
+void test_instrumentation(){
+    std::cout << "**********TEST STRUMENTAZIONE**********" << std::endl;
+    typedef SparseMatrix<int, std::allocator<int>, unsigned int, counting_instrumentation> counted;
+    assert(std::is_empty<no_instrumentation>::value);
+    assert(SparseMatrix<int>(2,2,0).getStats().lookups == 0);
+
+    counted m(10,10,0);
+    m.add(0,0,1);
+    m.add(0,1,2);
+    m.add(5,5,3);
+    m.add(0,0,4); // sovrascrittura con ricerca
+    m.add(1,0,5); // inserimento in mezzo, sposta (5,5)
+    m.add(6,0,6); // array pieno, riallocazione
+
+    sm_stats s = m.getStats();
+    assert(s.inserts == 5 && s.overwrites == 1);
+    assert(s.insertSteps > 0 && s.shifted == 1);
+    assert(s.allocations == 2 && s.allocated == 4 + 8);
+    assert(s.copied == 4); // elementi spostati nel nuovo array
+    assert(s.lookups == 0);
+
+    assert(m(0,0) == 4 && m(9,9) == 0);
+    s = m.getStats();
+    assert(s.lookups == 2 && s.lookupSteps > 0);
+
+    // la copia ha statistiche proprie
+    counted c(m);
+    assert(c.getStats().copied == 5 && c.getStats().allocations == 1 && c.getStats().inserts == 0);
+    assert(m.getStats().copied == 4);
+    counted d(1,1,0);
+    d = m;
+    assert(d.getStats().copied == 5);
+
+    m.resetStats();
+    assert(m.getStats().inserts == 0 && m.getStats().allocations == 0);
+
+    // letture concorrenti
+    run_parallel(4, [&](const unsigned int t){
+        for(unsigned int k = 0; k < 1000; ++k)
+            m(k % 10, t);
+    });
+    assert(m.getStats().lookups == 4000);
+}
+
+void test_mapped(){
+    std::cout << "**********TEST FORMATO BINARIO E MMAP**********" << std::endl;
+    const char *path = "test_matrix.bin";
+    SparseMatrix<double> sm(300,200,-1.5);
+    for(unsigned int k = 0; k < 5000; ++k)
+        sm.add((k * 37) % 300, (k * 11) % 200, k * 0.25);
+    sm.save(path);
+
+    {
+        MappedMatrix<double> mm(path);
+        assert(mm.getNumRows() == 300 && mm.getNumCols() == 200);
+        assert(mm.getNumElement() == sm.getNumElement());
+        assert(mm.getDefaultValue() == -1.5);
+        for(unsigned int i = 0; i < 300; ++i)
+            for(unsigned int j = 0; j < 200; ++j)
+                assert(mm(i,j) == sm(i,j));
+
+        SparseMatrix<double>::const_iterator e = sm.begin();
+        for(MappedMatrix<double>::const_iterator k = mm.begin(), ke = mm.end(); k != ke; ++k, ++e)
+            assert(k -> i == e -> i && k -> j == e -> j && (*k).value == e -> value);
+        assert(e == sm.end());
+
+        SparseMatrix<double> back = mm.toSparseMatrix();
+        assert(back.getNumElement() == sm.getNumElement() && back(37,11) == sm(37,11));
+
+        try{
+            mm(300,0);
+            assert(false);
+        }
+        catch(index_out_of_bounds_exception &e){}
+
+        // tipo del valore o degli indici diversi da quelli del file
+        try{
+            MappedMatrix<float> wrong(path);
+            assert(false);
+        }
+        catch(matrix_file_exception &e){}
+        try{
+            MappedMatrix<double, unsigned long long> wrong(path);
+            assert(false);
+        }
+        catch(matrix_file_exception &e){}
+    }
+
+    // matrice vuota e indici a 16 bit
+    SparseMatrix<int, std::allocator<int>, uint16_t> small(10,10,7);
+    small.save(path);
+    MappedMatrix<int, uint16_t> ms(path);
+    assert(ms.getNumElement() == 0 && ms(3,4) == 7 && ms.begin() == ms.end());
+
+    // file troncato
+    std::FILE *f = std::fopen(path, "wb");
+    std::fputs("SPMXBIN", f);
+    std::fclose(f);
+    try{
+        MappedMatrix<int, uint16_t> bad(path);
+        assert(false);
+    }
+    catch(matrix_file_exception &e){}
+    std::remove(path);
+
+    try{
+        MappedMatrix<int> missing(path);
+        assert(false);
+    }
+    catch(matrix_file_exception &e){}
+}
+
+// scrive un file di testo usato dai test Matrix Market
+void write_text(const char *path, const char *text){
+    std::FILE *f = std::fopen(path, "wb");
+    std::fputs(text, f);
+    std::fclose(f);
+}
+
+void test_matrix_market(){
+    std::cout << "**********TEST MATRIX MARKET**********" << std::endl;
+    const char *path = "test_matrix.mtx";
+
+    // andata e ritorno, con blocchi piccoli per spezzare le righe tra i blocchi
+    SparseMatrix<double> sm(300,200,0.0);
+    for(unsigned int k = 0; k < 5000; ++k)
+        sm.add((k * 37) % 300, (k * 11) % 200, k * 0.1 - 7);
+    write_matrix_market(sm, path);
+    SparseMatrix<double> back = read_matrix_market<double>(path, 0.0, 4, SparseMatrix<double>::last_wins, 16);
+    assert(back.getNumElement() == sm.getNumElement());
+    SparseMatrix<double>::const_iterator e = sm.begin();
+    for(SparseMatrix<double>::const_iterator k = back.begin(); k != back.end(); ++k, ++e)
+        assert(k -> i == e -> i && k -> j == e -> j && k -> value == e -> value);
+
+    SparseMatrix<int> si(4,4,-1);
+    si.add(3,0,-42);
+    write_matrix_market(si, path);
+    SparseMatrix<int> bi = read_matrix_market<int>(path, -1);
+    assert(bi.getNumElement() == 1 && bi(3,0) == -42 && bi(0,0) == -1);
+
+    // simmetrica: l'elemento fuori diagonale viene speculato
+    write_text(path, "%%MatrixMarket matrix coordinate real symmetric\n% commento\n3 3 2\n1 1 5\n3 1 2.5");
+    SparseMatrix<double> sym = read_matrix_market<double>(path);
+    assert(sym.getNumElement() == 3 && sym(0,0) == 5 && sym(2,0) == 2.5 && sym(0,2) == 2.5);
+
+    write_text(path, "%%MatrixMarket matrix coordinate integer skew-symmetric\n2 2 1\n2 1 3\n");
+    SparseMatrix<int> skew = read_matrix_market<int>(path, 0, 2);
+    assert(skew(1,0) == 3 && skew(0,1) == -3);
+
+    write_text(path, "%%MatrixMarket matrix coordinate pattern general\n2 3 2\n\n1 3\n2 2\n");
+    SparseMatrix<int> pat = read_matrix_market<int>(path);
+    assert(pat.getNumElement() == 2 && pat(0,2) == 1 && pat(1,1) == 1);
+
+    // duplicati: nell'ordine del file, anche tra blocchi diversi
+    write_text(path, "%%MatrixMarket matrix coordinate integer general\n3 3 4\n2 2 1\n1 3 4\n2 2 5\n2 2 7\n");
+    SparseMatrix<int> last = read_matrix_market<int>(path, 0, 2, SparseMatrix<int>::last_wins, 8);
+    assert(last.getNumElement() == 2 && last(1,1) == 7 && last(0,2) == 4);
+    SparseMatrix<int> total = read_matrix_market<int>(path, 0, 2, SparseMatrix<int>::sum, 8);
+    assert(total.getNumElement() == 2 && total(1,1) == 13 && total(0,2) == 4);
+
+    // file non validi
+    const char *bad[] = {
+        "%%MatrixMarket matrix array real general\n2 2\n1\n2\n3\n4\n",
+        "%%MatrixMarket matrix coordinate real general\n2 2 2\n1 1 1\n",
+        "%%MatrixMarket matrix coordinate real general\n2 2 1\n1 x 1\n",
+        "%%MatrixMarket matrix coordinate real general\n2 2 1\n1\n2 1\n",
+        // piu' righe di quelle dichiarate
+        "%%MatrixMarket matrix coordinate real general\n2 2 2\n1 1 1\n1 2 2\n2 1 3\n2 2 4\n",
+        // numero di elementi enorme: non deve essere usato per riservare memoria
+        "%%MatrixMarket matrix coordinate real general\n2 2 1152921504606846976\n1 1 1\n",
+        "%%MatrixMarket matrix coordinate real symmetric\n2 2 18446744073709551615\n2 1 1\n"
+    };
+    for(unsigned int k = 0; k < sizeof(bad) / sizeof(bad[0]); ++k){
+        write_text(path, bad[k]);
+        try{
+            read_matrix_market<double>(path, 0.0, 2);
+            assert(false);
+        }
+        catch(matrix_file_exception &e){}
+        // a blocchi piccoli le righe in eccesso vengono rifiutate prima della fine del file
+        try{
+            read_matrix_market<double>(path, 0.0, 1, SparseMatrix<double>::last_wins, 8);
+            assert(false);
+        }
+        catch(matrix_file_exception &e){}
+    }
+
+    write_text(path, "%%MatrixMarket matrix coordinate real general\n2 2 1\n3 1 1\n");
+    try{
+        read_matrix_market<double>(path);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+    std::remove(path);
+}
+
+void test_concurrent(){
+    std::cout << "**********TEST MATRICE CONCORRENTE**********" << std::endl;
+    ConcurrentMatrix<int> cm(1000,50,-1,16);
+    assert(cm.getNumShards() == 16 && cm.getNumRows() == 1000 && cm.getDefaultValue() == -1);
+
+    // 4 thread scrivono celle diverse mentre altri 4 leggono
+    run_parallel(8, [&](const unsigned int t){
+        for(unsigned int k = 0; k < 2000; ++k){
+            const unsigned int i = (k * 7 + t * 131) % 1000, j = (k + t) % 50;
+            if(t < 4)
+                cm.add(i, j, static_cast<int>(t));
+            else{
+                const int v = cm(i, j);
+                assert(v >= -1 && v < 4);
+            }
+        }
+    });
+
+    SparseMatrix<int> snap = cm.toSparseMatrix();
+    assert(snap.getNumElement() == cm.getNumElement());
+    for(unsigned int i = 0; i < 1000; ++i)
+        for(unsigned int j = 0; j < 50; ++j)
+            assert(snap(i,j) == cm(i,j));
+
+    // la visita e' in ordine di riga, con coordinate globali
+    unsigned int n = 0, prevI = 0, prevJ = 0;
+    cm.for_each([&](const unsigned int i, const unsigned int j, const int v){
+        assert(n == 0 || prevI < i || (prevI == i && prevJ < j));
+        assert(snap(i,j) == v);
+        prevI = i;
+        prevJ = j;
+        ++n;
+    });
+    assert(n == snap.getNumElement());
+
+    // piu' shard che righe, righe non multiple del numero di shard
+    ConcurrentMatrix<int> small(3,3,0,8), odd(10,2,0,4);
+    assert(small.getNumShards() == 3);
+    odd.add(9,1,5);
+    assert(odd(9,1) == 5 && odd.toSparseMatrix()(9,1) == 5);
+    assert(small.toSparseMatrix().getNumElement() == 0 && odd.toSparseMatrix().getNumElement() == 1);
+
+    // letture condivise: mentre for_each tiene in lettura lo shard della riga 0,
+    // un altro thread legge la stessa riga (con un lock esclusivo non finirebbe)
+    small.add(0,0,7);
+    std::atomic<bool> inside(false), done(false);
+    run_parallel(2, [&](const unsigned int t){
+        if(t == 0)
+            small.for_each([&](const unsigned int, const unsigned int, const int){
+                inside = true;
+                while(!done)
+                    std::this_thread::yield();
+            });
+        else{
+            while(!inside)
+                std::this_thread::yield();
+            assert(small(0,0) == 7);
+            done = true;
+        }
+    });
+
+    try{
+        cm.add(1000,0,1);
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+}
+
+void test_snapshot(){
+    std::cout << "**********TEST VERSIONI**********" << std::endl;
+    SparseMatrix<int> first(20,20,0);
+    for(unsigned int k = 0; k < 20; ++k)
+        first.add(k, k, 0);
+    SnapshotMatrix<int> sm(first);
+
+    SnapshotMatrix<int>::snapshot_type old = sm.snapshot();
+    sm.update([](SparseMatrix<int> &m){ m.add(3,4,7); });
+    assert((*old)(3,4) == 0 && (*sm.snapshot())(3,4) == 7); // la vecchia versione non cambia
+
+    // la vecchia versione viene liberata quando nessun lettore la usa piu'
+    assert(sm.reclaim() == 1);
+    SnapshotMatrix<int>::snapshot_type moved(std::move(old));
+    assert(!old && moved && sm.reclaim() == 1);
+    moved.reset();
+    assert(sm.reclaim() == 0);
+
+    // le versioni si spostano senza eccezioni, anche quando il vector cresce
+    static_assert(std::is_nothrow_move_constructible<SnapshotMatrix<int>::snapshot_type>::value, "snapshot_type");
+    std::vector<SnapshotMatrix<int>::snapshot_type> held;
+    for(unsigned int k = 0; k < 10; ++k)
+        held.push_back(sm.snapshot());
+    assert((*held[0])(3,4) == 7 && (*held[9])(3,4) == 7);
+    held.clear();
+    assert(sm.reclaim() == 0);
+
+    // letture durante le scritture: ogni versione ha tutta la diagonale uguale
+    // al proprio numero e ogni lettore vede numeri non decrescenti; ogni lettore
+    // tiene due versioni alla volta
+    run_parallel(4, [&](const unsigned int t){
+        SnapshotMatrix<int>::snapshot_type prev;
+        for(int v = 1; v <= 200; ++v){
+            if(t == 0){
+                sm.update([v](SparseMatrix<int> &m){
+                    for(unsigned int k = 0; k < 20; ++k)
+                        m.add(k, k, v);
+                });
+            }
+            else{
+                SnapshotMatrix<int>::snapshot_type s = sm.snapshot();
+                const int d = (*s)(0,0);
+                for(unsigned int k = 1; k < 20; ++k)
+                    assert((*s)(k,k) == d);
+                assert(!prev || (*prev)(0,0) <= d);
+                prev = std::move(s);
+            }
+        }
+    });
+    assert((*sm.snapshot())(19,19) == 200 && sm.reclaim() == 0);
+
+    sm.publish(SparseMatrix<int>(2,2,5));
+    assert(sm.snapshot() -> getNumRows() == 2 && (*sm.snapshot())(1,1) == 5);
+
+    try{
+        sm.update([](SparseMatrix<int> &m){ m.add(9,9,1); });
+        assert(false);
+    }
+    catch(index_out_of_bounds_exception &e){}
+    assert(sm.snapshot() -> getNumElement() == 0);
+}
+
 int main(){
     
     test_element(); // ma element va privato????!
@@ -262,6 +1570,30 @@ int main(){
     test_evaluate();
 
     test_iterator();
+    test_ordering();
+    test_compressed();
+    test_dok();
+    test_row_index();
+    test_assign();
+    test_allocator();
+    test_move();
+    test_multiply();
+    test_simd();
+    test_spgemm();
+    test_add_batch();
+    test_lookup_batch();
+    test_erase();
+    test_elementwise();
+    test_expression();
+    test_transpose();
+    test_submatrix();
+    test_evaluate_policy();
+    test_index_type();
+    test_instrumentation();
+    test_mapped();
+    test_matrix_market();
+    test_concurrent();
+    test_snapshot();
    
    /*  
     std::vector<SparseMatrix<int>> sm(5);